@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defer.h"
+#include "error.h"
+
+// Size of the chunks mapped by an arena initialized with a chunk size of 0.
+#ifndef WINTER_ARENA_CHUNK_SIZE
+#define WINTER_ARENA_CHUNK_SIZE (1 << 20)
+#endif
+
+typedef struct arena_chunk arena_chunk_t;
+
+/// Bump allocator over chunks of mapped memory. Allocations are zeroed and freed all at once by arena_reset(), which
+/// keeps the chunks for the next allocations.
+typedef struct {
+    size_t chunk_size;
+
+    arena_chunk_t* first;
+    arena_chunk_t* current;
+    unsigned char* cursor;
+    unsigned char* end;
+} arena_t;
+
+/// Allocator of objects of a single size, backed by an arena. Freed objects are reused by the next allocations.
+typedef struct {
+    arena_t arena;
+    size_t size;
+    void* free;
+} pool_t;
+
+/// Initializes an empty arena, no memory is mapped until the first allocation.
+result_t
+arena_init(arena_t* arena, size_t chunk_size);
+
+/// Allocates size zeroed bytes aligned to align, which has to be a power of two.
+result_t
+arena_alloc(arena_t* arena, size_t size, size_t align, void** ptr);
+
+/// Frees every allocation of the arena in constant time. The mapped chunks are kept and reused.
+void
+arena_reset(arena_t* arena);
+
+/// Unmaps the chunks of the arena.
+void
+arena_destroy(arena_t* arena);
+
+/// Initializes an empty pool of objects of the size.
+result_t
+pool_init(pool_t* pool, size_t size, size_t chunk_size);
+
+/// Allocates a zeroed object.
+result_t
+pool_alloc(pool_t* pool, void** ptr);
+
+/// Returns an object to the pool.
+void
+pool_free(pool_t* pool, void* ptr);
+
+/// Frees every object of the pool in constant time.
+void
+pool_reset(pool_t* pool);
+
+/// Unmaps the memory of the pool.
+void
+pool_destroy(pool_t* pool);
+
+#define try_arena_alloc(arena, ptr, size)                                                                              \
+    try(arena_alloc(arena, size, _Alignof(max_align_t), (void**)&(ptr)), msg("no memory for: " #ptr), with_int(size))
+
+#define try_pool_alloc(pool, ptr) try(pool_alloc(pool, (void**)&(ptr)), msg("no memory for: " #ptr))
+
+defer_impl(arena_reset) {
+    defer_guard();
+    arena_reset(defer_arg(arena_t));
+}
+
+defer_impl(arena_destroy) {
+    defer_guard();
+    arena_destroy(defer_arg(arena_t));
+}
+
+defer_impl(pool_reset) {
+    defer_guard();
+    pool_reset(defer_arg(pool_t));
+}
+
+defer_impl(pool_destroy) {
+    defer_guard();
+    pool_destroy(defer_arg(pool_t));
+}
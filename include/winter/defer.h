@@ -6,6 +6,10 @@
 #include "error.h"
 #include "utils.h"
 
+// Records the file, function and line of every defer for debugging the cleanups, which costs stack space and stores
+// in every scope with a defer.
+#ifdef WINTER_DEFER_DEBUG
+
 typedef struct {
     void* arg;
     bool err;
@@ -25,8 +29,30 @@ typedef struct {
         .arg = (void*)&args, .err = true, .line = __LINE__, .file = __FILE__, .func = __FUNCTION__                     \
     }
 
+#else
+
+typedef struct {
+    void* arg;
+    bool err;
+} defer_t;
+
+#define defer(fun, args)                                                                                               \
+    defer_t concat(defer_, __COUNTER__) __attribute__((unused, __cleanup__(defer_##fun))) = {                          \
+        .arg = (void*)&args, .err = false                                                                              \
+    }
+
+#define errdefer(fun, args)                                                                                            \
+    defer_t concat(defer_, __COUNTER__) __attribute__((unused, __cleanup__(defer_##fun))) = {                          \
+        .arg = (void*)&args, .err = true                                                                               \
+    }
+
+#endif
+
+// cleanups are always inlined, so the defer_t of a scope is folded into a direct call
 #define defer_impl(name)                                                                                               \
-    __attribute__((unused)) static inline void defer_##name(__attribute__((unused)) const defer_t* __defer)
+    __attribute__((unused, always_inline)) static inline void defer_##name(                                            \
+      __attribute__((unused)) const defer_t* __defer                                                                   \
+    )
 
 #define defer_arg(type) ((type*)__defer->arg)
 
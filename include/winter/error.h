@@ -1,6 +1,8 @@
 #pragma once
 
 #include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -9,20 +11,107 @@
 #define SUCCESS 0
 #define FAILURE 1
 
+#define WINTER_ERROR_LEVEL_CODE 0
+#define WINTER_ERROR_LEVEL_SITES 1
+#define WINTER_ERROR_LEVEL_FULL 2
+
+// How much of an error is recorded: the full trace with messages, the trace of codes and sites without messages or
+// only the last code. Has to be the same for every translation unit including src/error.c, so set it in the CFLAGS.
+#ifndef WINTER_ERROR_LEVEL
+#define WINTER_ERROR_LEVEL WINTER_ERROR_LEVEL_FULL
+#endif
+
+// Number of frames kept per thread, further frames are counted but not stored.
+#ifndef WINTER_MAX_ERRORS
+#define WINTER_MAX_ERRORS 32
+#endif
+
+#if WINTER_ERROR_LEVEL >= WINTER_ERROR_LEVEL_FULL
+#define WINTER_ERROR_MSG_SIZE 256
+#else
+#define WINTER_ERROR_MSG_SIZE 1
+#endif
+
 typedef struct {
     const char* file;
     const char* func;
     uint32_t line;
 
     int32_t code;
-    char msg[256];
+
+    // until the frame is read through error_trace_nth, msg holds the format strings and raw arguments of the appended
+    // messages instead of text, so errors that are handled and cleared are never formatted
+    uint16_t size;
+    bool rendered;
+    char msg[WINTER_ERROR_MSG_SIZE];
 } error_frame_t;
 
+/// Last error code reported by the current thread, use error_get_code() to read it.
+extern _Thread_local int32_t error_last_code;
+
+/// Counter of a failure() or ensure() call site, enabled by defining WINTER_ERROR_COUNTERS. Sites are registered in a
+/// process wide list the first time they fail, read the fields with atomic loads while other threads may fail.
+typedef struct error_site {
+    const char* file;
+    const char* func;
+    uint32_t line;
+
+    _Atomic int32_t code;
+    _Atomic uint64_t count;
+    struct error_site* _Atomic next;
+} error_site_t;
+
+/// Adds the site to the list of sites, called once per site.
+void
+error_site_register(error_site_t* site);
+
+/// Returns the most recently registered site, or null if no site failed yet. Sites failing for the first time are added
+/// at the front, a started iteration does not see them.
+error_site_t*
+error_sites_first(void);
+
+/// Returns the site registered before this one, or null if it was the first.
+error_site_t*
+error_sites_next(const error_site_t* site);
+
+/// Copy of the counter of a site at one point in time.
+typedef struct {
+    const char* file;
+    const char* func;
+    uint32_t line;
+
+    int32_t code;
+    uint64_t count;
+} error_site_snapshot_t;
+
+/// Copies up to capacity sites into the snapshots. Returns the number of registered sites, which may be larger.
+uint32_t
+error_sites_snapshot(error_site_snapshot_t* snapshots, uint32_t capacity);
+
+__attribute__((unused)) static inline void
+error_site_hit(error_site_t* site, const int32_t code) {
+    atomic_store_explicit(&site->code, code, memory_order_relaxed);
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) == 0) {
+        error_site_register(site);
+    }
+}
+
+#ifdef WINTER_ERROR_COUNTERS
+#define error_count_site(code)                                                                                         \
+    do {                                                                                                               \
+        static error_site_t _error_site = { .file = __FILE__, .func = __FUNCTION__, .line = __LINE__ };                \
+        error_site_hit(&_error_site, code);                                                                            \
+    } while (0)
+#else
+#define error_count_site(code) ((void)0)
+#endif
+
 /// Reports a thread local error.
 void
 error_push(const char* file, const char* func, uint32_t line, int32_t code);
 
-/// Appends a message to the last reported error by the current thread.
+/// Appends a message to the last reported error by the current thread. The arguments are recorded and only formatted
+/// when the frame is read, strings are copied.
 __attribute__((__format__(__printf__, 1, 0))) void
 error_append_message(const char* format, ...);
 
@@ -34,7 +123,7 @@ error_get_code(void);
 uint32_t
 error_trace_length(void);
 
-/// Gets the nth frame of the error trace or null if the index is out of bounds.
+/// Gets the nth frame of the error trace or null if the index is out of bounds. Renders the message of the frame.
 error_frame_t*
 error_trace_nth(uint32_t n);
 
@@ -42,15 +131,86 @@ error_trace_nth(uint32_t n);
 void
 error_clear(void);
 
+/// Trace of a thread moved out of its thread local state by error_capture(), so it can be rethrown by another thread.
+/// Frames are copied as they are and messages not rendered yet stay unformatted.
+typedef struct error_capture error_capture_t;
+
+/// Returns the number of bytes needed to capture the trace of the current thread.
+size_t
+error_capture_size(void);
+
+/// Captures the trace of the current thread into the pointer aligned buffer owned by the caller and clears the trace.
+/// Returns null and keeps the trace if the buffer is smaller than error_capture_size().
+error_capture_t*
+error_capture_into(void* buffer, size_t size);
+
+/// Captures the trace of the current thread into a single allocation and clears the trace. Returns null and keeps the
+/// trace if the allocation fails. Free the capture with error_capture_free().
+error_capture_t*
+error_capture(void);
+
+/// Frees a capture returned by error_capture().
+void
+error_capture_free(error_capture_t* capture);
+
+/// Appends the frames of the capture to the trace of the current thread and sets its error code. Returns FAILURE, or
+/// SUCCESS if the capture holds no error. The capture can be rethrown again.
+result_t
+error_rethrow(const error_capture_t* capture);
+
 #define ecode error_get_code()
 
+#if WINTER_ERROR_LEVEL == WINTER_ERROR_LEVEL_CODE
+
+// only the code is stored, a propagating try is a branch and the failure that started it a single store
 #define failure(code, ...)                                                                                             \
+    do {                                                                                                               \
+        const int32_t _error_code = (code);                                                                            \
+        error_count_site(_error_code);                                                                                 \
+        error_last_code = _error_code;                                                                                 \
+        __VA_OPT__(error_unevaluated((__VA_ARGS__));)                                                                  \
+        return FAILURE;                                                                                                \
+    } while (0)
+
+#define ensure(expr, ...)                                                                                              \
+    do {                                                                                                               \
+        if (!(expr)) {                                                                                                 \
+            failure(EINVAL __VA_OPT__(, __VA_ARGS__));                                                                 \
+        }                                                                                                              \
+    } while (0)
+
+#define try(expr, ...)                                                                                                 \
+    do {                                                                                                               \
+        if ((expr) != SUCCESS) {                                                                                       \
+            __VA_OPT__(error_unevaluated((__VA_ARGS__));)                                                              \
+            return FAILURE;                                                                                            \
+        }                                                                                                              \
+    } while (0)
+
+#define forward(...)                                                                                                   \
+    do {                                                                                                               \
+        (void)__state;                                                                                                 \
+        __VA_OPT__(error_unevaluated((__VA_ARGS__));)                                                                  \
+        return FAILURE;                                                                                                \
+    } while (0)
+
+#else
+
+// pushes a frame and returns, without counting the site
+#define error_return(code, ...)                                                                                        \
     do {                                                                                                               \
         error_push(__FILE__, __FUNCTION__, __LINE__, code);                                                            \
         (void)(__VA_ARGS__);                                                                                           \
         return FAILURE;                                                                                                \
     } while (0)
 
+#define failure(code, ...)                                                                                             \
+    do {                                                                                                               \
+        const int32_t _error_code = (code);                                                                            \
+        error_count_site(_error_code);                                                                                 \
+        error_return(_error_code, __VA_ARGS__);                                                                        \
+    } while (0)
+
 #define ensure(expr, ...)                                                                                              \
     do {                                                                                                               \
         if (!(expr)) {                                                                                                 \
@@ -61,10 +221,15 @@ error_clear(void);
 #define try(expr, ...)                                                                                                 \
     do {                                                                                                               \
         if ((expr) != SUCCESS) {                                                                                       \
-            failure(error_get_code(), msg("try %s", #expr) __VA_OPT__(, __VA_ARGS__));                                 \
+            error_return(error_get_code(), msg("try %s", #expr) __VA_OPT__(, __VA_ARGS__));                            \
         }                                                                                                              \
     } while (0)
 
+#define forward(...)                                                                                                   \
+    error_return(error_get_code(), msg("handler for: %s", __state.expr_str) __VA_OPT__(, __VA_ARGS__))
+
+#endif
+
 #define handle(expr)                                                                                                   \
     for (struct {                                                                                                      \
              const char* expr_str;                                                                                     \
@@ -73,7 +238,7 @@ error_clear(void);
          __state.result != SUCCESS;                                                                                    \
          error_clear(), __state.result = SUCCESS)
 
-#define forward(...) failure(error_get_code(), msg("handler for: %s", __state.expr_str) __VA_OPT__(, __VA_ARGS__))
+#if WINTER_ERROR_LEVEL >= WINTER_ERROR_LEVEL_FULL
 
 #define msg(msg, ...) error_append_message(msg __VA_OPT__(, __VA_ARGS__))
 
@@ -86,3 +251,22 @@ error_clear(void);
 #define with_ptr(expr) error_append_message(", %s = %p", #expr, (void*)(expr))
 
 #define with_str(expr) error_append_message(", %s = %s", #expr, expr)
+
+#else
+
+// messages are not recorded, their arguments are type checked but not evaluated
+#define error_unevaluated(expr) ((void)sizeof((void)(expr), 0))
+
+#define msg(msg, ...) error_unevaluated(error_append_message(msg __VA_OPT__(, __VA_ARGS__)))
+
+#define with_int(expr) error_unevaluated((intmax_t)(expr))
+
+#define with_uint(expr) error_unevaluated((uintmax_t)(expr))
+
+#define with_dbl(expr) error_unevaluated((long double)(expr))
+
+#define with_ptr(expr) error_unevaluated((void*)(expr))
+
+#define with_str(expr) error_unevaluated((const char*)(expr))
+
+#endif
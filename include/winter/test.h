@@ -30,8 +30,17 @@
 
 #pragma once
 
+// the CPU affinity interface of glibc is only declared for GNU sources, this only has an effect if the header is
+// included before any system header
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
 #include <fnmatch.h>
+#include <math.h>
 #include <pthread.h>
+#include <setjmp.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -39,11 +48,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/errno.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <sys/event.h>
+#endif
+
+#ifdef WINTER_ALLOC_TRACKING
+#if defined(__linux__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+#endif
+
 #include "error.h"
 
 #include <stdatomic.h>
@@ -55,6 +88,39 @@
 #define WINTER_DEFAULT_TIMEOUT_MS 2000
 #define WINTER_PROCESS_POLL_MS 5
 
+#define WINTER_HISTORY_SAMPLES 8
+
+#define WINTER_ADAPTIVE_TIMEOUT_SAMPLES 3
+#define WINTER_ADAPTIVE_TIMEOUT_FACTOR 10.0
+#define WINTER_ADAPTIVE_TIMEOUT_MIN_MS 100.0
+#define WINTER_ADAPTIVE_TIMEOUT_MAX_MS 60000.0
+
+#define WINTER_OUTPUT_MEMORY_MAX (1 << 20)
+#define WINTER_OUTPUT_BUFFER_SIZE (1 << 16)
+
+#define WINTER_RECORDS 256
+
+#define WINTER_BATCH_SIZE 64
+
+#define WINTER_MAX_CPUS 1024
+#define WINTER_BARRIER_SPINS 1024
+#define WINTER_BARRIER_BACKOFF 32
+
+#define WINTER_BENCH_TIMEOUT_MS 30000
+#define WINTER_BENCH_SAMPLES 100
+#define WINTER_BENCH_MIN_SAMPLES 10
+#define WINTER_BENCH_SAMPLE_NS 1000000ULL
+#define WINTER_BENCH_WARMUP_NS 100000000ULL
+#define WINTER_BENCH_BUDGET_NS 5000000000ULL
+#define WINTER_BENCH_THRESHOLD 5.0
+#define WINTER_BENCH_ALPHA 0.01
+
+#define WINTER_PROPERTY_TIMEOUT_MS 60000
+#define WINTER_PROPERTY_CHOICES 4096
+#define WINTER_PROPERTY_SHRINKS 10000
+#define WINTER_PROPERTY_BLOCK 8
+#define WINTER_PROPERTY_STEPS 4
+
 #define WINTER_COLOR_BOLD "\033[1m"
 #define WINTER_COLOR_RESET "\033[0m"
 #define WINTER_COLOR_SUCCESS "\033[32m"
@@ -64,9 +130,18 @@
 
 #define WINTER_FUNC __attribute__((unused)) static
 
-#define WINTER_FUNC_INFO 0
+// suite functions are compiled without optimizations unless WINTER_OPTIMIZE is defined, so that benchmarks and stress
+// tests can measure optimized code
+#ifdef WINTER_OPTIMIZE
+#define WINTER_SUITE_FUNC static
+#else
+#define WINTER_SUITE_FUNC __attribute__((optnone)) static
+#endif
+
 #define WINTER_FUNC_BEFORE_EACH 1
 #define WINTER_FUNC_AFTER_EACH 2
+#define WINTER_FUNC_BEFORE_ALL 3
+#define WINTER_FUNC_AFTER_ALL 4
 
 #define WINTER_EXIT_FAILURE 255
 
@@ -78,6 +153,27 @@ enum {
     _WINTER_OPT_DEBUG,
     _WINTER_OPT_RERUN,
     _WINTER_OPT_TIMEOUT,
+    _WINTER_OPT_JOBS,
+    _WINTER_OPT_BENCH,
+    _WINTER_OPT_REPORTER,
+    _WINTER_OPT_SHARD,
+    _WINTER_OPT_HISTORY,
+    _WINTER_OPT_WEIGHTED,
+    _WINTER_OPT_FAILED_FIRST,
+    _WINTER_OPT_ONLY_FAILED,
+    _WINTER_OPT_BARRIER,
+    _WINTER_OPT_AFFINITY,
+    _WINTER_OPT_BENCH_SAVE,
+    _WINTER_OPT_BENCH_COMPARE,
+    _WINTER_OPT_BENCH_THRESHOLD,
+    _WINTER_OPT_COUNTERS,
+    _WINTER_OPT_SEED,
+    _WINTER_OPT_BATCH,
+    _WINTER_OPT_ADAPTIVE_TIMEOUT,
+    _WINTER_OPT_TIMEOUT_BOUNDS,
+    _WINTER_OPT_REPEAT,
+    _WINTER_OPT_STRESS,
+    _WINTER_OPT_JITTER,
     _WINTER_OPT_LAST,
 };
 
@@ -88,25 +184,310 @@ typedef struct {
     size_t allocated;
 } winter_array_t;
 
+/// Implementation of synchronize(). The mutex barrier sleeps in the kernel, the spin barrier busy waits with a growing
+/// backoff before falling back to a futex, so all threads leave it within nanoseconds of each other.
+typedef enum {
+    WINTER_BARRIER_DEFAULT,
+    WINTER_BARRIER_MUTEX,
+    WINTER_BARRIER_SPIN,
+} winter_barrier_t;
+
+/// Resource limits of a test, checked against the resource usage of the test process after it exited. Zero means
+/// unlimited.
+typedef struct {
+    uint64_t max_rss_mb;
+    uint64_t max_minor_faults;
+    uint64_t max_major_faults;
+    uint64_t max_switches;
+    uint64_t max_allocs;
+} winter_budget_t;
+
 typedef struct {
     const char* name;
     uint64_t id;
     uint16_t threads;
     double timeout;
+    bool bench;
+    bool property;
+    winter_barrier_t barrier;
+
+    // spread, compact or a list of CPUs like 0,2,4-7 the threads are pinned to, in order of the logical CPU numbers
+    const char* affinity;
+
+    // the fields of the budget are members of the test as well, so they can be given to test() directly
+    union {
+        winter_budget_t budget;
+        struct {
+            uint64_t max_rss_mb;
+            uint64_t max_minor_faults;
+            uint64_t max_major_faults;
+            uint64_t max_switches;
+            uint64_t max_allocs;
+        };
+    };
+
+    // address of the label in front of the test body, the suite function and the file it is in identify the suite
+    void* entry;
+    const char* function;
+    const char* file;
 } winter_test_t;
 
+/// Static description of a describe() block, the tests of the suite are the tests in its function.
+typedef struct {
+    const char* name;
+    const char* function;
+    const char* file;
+    unsigned line;
+    void (*func)(uint64_t);
+} winter_suite_descriptor_t;
+
 typedef struct {
     const char* name;
+    const char* function;
+    const char* file;
+    unsigned line;
     winter_array_t tests;
-    void (*func)(uint64_t, winter_array_t*);
+    void (*func)(uint64_t);
+
+    // selection by the patterns, filled in when the patterns are compiled
+    bool matched;
+    bool match_all;
+    winter_array_t globs;
 } winter_suite_t;
 
+/// A suite:test pattern split once when it is parsed. Tests without glob characters are matched by their hash.
+typedef struct {
+    char* suite;
+    const char* test;
+    bool glob;
+
+    uint64_t suite_hash;
+    uint64_t hash;
+} winter_pattern_t;
+
+/// Outcome and most recent durations of one unit in previous runs, keyed by the hash of its suite and test name.
+typedef struct {
+    uint64_t hash;
+    char* name;
+
+    bool failed;
+    uint32_t shard;
+
+    // most recent duration first
+    uint32_t count;
+    uint64_t durations[WINTER_HISTORY_SAMPLES];
+} winter_history_t;
+
+/// Statistics of the samples of a benchmark in nanoseconds per iteration.
+typedef struct {
+    uint32_t count;
+    double mean;
+    double variance;
+    double median;
+} winter_bench_stats_t;
+
+/// Stored result of a benchmark keyed like the history, the baseline is read from --bench-compare and the result is
+/// written to --bench-save.
+typedef struct {
+    uint64_t hash;
+    char* name;
+
+    bool has_baseline;
+    winter_bench_stats_t baseline;
+    bool has_result;
+    winter_bench_stats_t result;
+} winter_baseline_t;
+
+/// Sort record for longest first orderings, ties are broken by the key so the order is the same on every machine.
+typedef struct {
+    uint64_t key;
+    uint64_t weight;
+} winter_weight_t;
+
+/// Allocations made while the body of a test runs, counted when WINTER_ALLOC_TRACKING is defined. The counters live in
+/// memory shared between the test process and the runner, sizes are the usable sizes of the blocks.
+typedef struct {
+    bool available;
+    _Atomic uint64_t allocs;
+    _Atomic uint64_t frees;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t freed_bytes;
+} winter_allocs_t;
+
+/// Output of a test process, read from a pipe while the process runs. Up to WINTER_OUTPUT_MEMORY_MAX bytes are kept in
+/// memory, more output moves everything into a temporary file.
+typedef struct {
+    int fd;
+
+    char* data;
+    size_t length;
+    size_t capacity;
+    FILE* spill;
+} winter_output_t;
+
+typedef enum {
+    WINTER_RECORD_FAILURE,
+    WINTER_RECORD_METRIC,
+} winter_record_kind_t;
+
+/// Fixed size record of a test process. Strings point into the binary, which the test process shares with the runner
+/// it was forked from.
+typedef struct {
+    winter_record_kind_t kind;
+    uint64_t time;
+
+    union {
+        // location of the assertion that ended the test
+        struct {
+            const char* file;
+            uint32_t line;
+        } failure;
+
+        // value reported through metric()
+        struct {
+            const char* name;
+            double value;
+        } metric;
+    };
+} winter_record_t;
+
+/// Records of a test process in memory shared with the runner, which reads them once the process ended. Writers claim
+/// a record with an atomic increment of the head, the oldest records are overwritten once the ring is full.
+typedef struct {
+    _Atomic uint32_t head;
+
+    // index of the record in a slot plus one once it is complete, a process killed while writing leaves it behind
+    _Atomic uint32_t sequences[WINTER_RECORDS];
+    winter_record_t records[WINTER_RECORDS];
+} winter_ring_t;
+
+typedef enum {
+    WINTER_COUNTER_CYCLES,
+    WINTER_COUNTER_INSTRUCTIONS,
+    WINTER_COUNTER_L1_MISSES,
+    WINTER_COUNTER_LLC_MISSES,
+    WINTER_COUNTER_BRANCH_MISSES,
+    WINTER_COUNTER_LAST,
+} winter_counter_t;
+
+/// Hardware counters of the user space code of a test body with --counters, shared between the test process and the
+/// runner. Counters the kernel or the CPU do not provide are not available.
+typedef struct {
+    bool available[WINTER_COUNTER_LAST];
+    uint64_t values[WINTER_COUNTER_LAST];
+} winter_counters_t;
+
+/// Progress of a unit that is repeated with --repeat, --stress or --jitter, shared between the test process and the
+/// runner. The runner measures the timeout from the start of the running iteration and reports the one that failed.
+typedef struct {
+    _Atomic uint64_t iteration;
+    _Atomic uint64_t start_time;
+    _Atomic uint64_t seed;
+} winter_repeat_t;
+
+/// Raw reading of a counter, scaled by the time it was enabled and running if the kernel multiplexed it.
+typedef struct {
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+} winter_counter_read_t;
+
+typedef enum {
+    _WINTER_SHRINK_DELETE,
+    _WINTER_SHRINK_LOWER,
+} winter_shrink_pass_t;
+
+/// Greedy shrinker of the choices of a failing case. Candidates delete blocks of choices or lower one choice by binary
+/// search followed by a few single steps, a candidate that still fails replaces the best choices if it is shorter or
+/// lexicographically smaller.
+typedef struct {
+    winter_shrink_pass_t pass;
+    uint32_t position;
+    uint32_t block;
+    bool improved;
+
+    // binary search of the choice at the position, high is known to fail
+    bool searching;
+    uint64_t low;
+    uint64_t high;
+    uint64_t tried;
+
+    // choices right below the end of the search that were tried one by one, failing is not monotonic in the choice
+    // since gen_int alternates between positive and negative values
+    uint32_t step;
+
+    uint32_t attempts;
+    uint32_t steps;
+
+    uint32_t length;
+    uint64_t choices[WINTER_PROPERTY_CHOICES];
+} winter_shrink_t;
+
+typedef enum {
+    _WINTER_PROPERTY_GENERATE,
+    _WINTER_PROPERTY_SHRINK,
+    _WINTER_PROPERTY_FINAL,
+    _WINTER_PROPERTY_REPLAY,
+} winter_property_phase_t;
+
+/// State of a property block. Every generator draws its values from a sequence of choices, so a case is reproduced by
+/// its choices and shrunk by shrinking them. Lives in memory shared with the runner, which replays the choices of a
+/// case that crashed the test process in new processes.
+typedef struct winter_property {
+    winter_property_phase_t phase;
+    bool verbose;
+
+    uint64_t iterations;
+    uint64_t cases;
+    uint64_t seed;
+    uint64_t next_seed;
+    uint64_t state;
+
+    bool running;
+    bool failed;
+    bool reported;
+
+    // the first length choices are replayed, the following ones are drawn or zero while replaying
+    bool replaying;
+    bool overflow;
+    uint32_t index;
+    uint32_t length;
+    uint64_t choices[WINTER_PROPERTY_CHOICES];
+
+    winter_shrink_t shrink;
+    sigjmp_buf jump;
+
+    // failures of the cases before the shrunk one are not printed
+    FILE* quiet;
+    FILE* output;
+} winter_property_t;
+
+typedef enum {
+    WINTER_REPORTER_TEXT,
+    WINTER_REPORTER_JSON,
+    WINTER_REPORTER_JUNIT,
+} winter_reporter_t;
+
 typedef struct {
     bool initialized;
 
     winter_array_t suites;
     winter_array_t patterns;
 
+    // open addressing tables of suite names to suite indices and of exact unit names to patterns
+    struct {
+        uint64_t* hashes;
+        size_t* suites;
+        size_t capacity;
+    } index;
+
+    struct {
+        uint64_t* hashes;
+        const winter_pattern_t** patterns;
+        size_t length;
+        size_t capacity;
+    } exact;
+
     struct {
         pthread_mutex_t mutex;
         FILE* file;
@@ -117,15 +498,74 @@ typedef struct {
         bool color;
         bool rerun;
         bool timeout;
+        bool bench;
+        uint32_t jobs;
+        winter_reporter_t reporter;
+        uint32_t shard_index;
+        uint32_t shard_count;
+        bool weighted;
+        bool failed_first;
+        bool only_failed;
+        winter_barrier_t barrier;
+        const char* affinity;
+        const char* bench_save;
+        const char* bench_compare;
+        double bench_threshold;
+        bool counters;
+        bool seeded;
+        uint64_t seed;
+        bool batch;
+        bool adaptive_timeout;
+        double timeout_min;
+        double timeout_max;
+        uint64_t repeat;
+        uint64_t stress_ns;
+        uint64_t jitter_ns;
     } opts;
 
+    winter_array_t baselines;
+
+    struct {
+        const char* path;
+        winter_history_t* entries;
+        size_t length;
+        size_t capacity;
+    } history;
+
     struct {
+        winter_barrier_t barrier;
         pthread_mutex_t mutex;
         pthread_cond_t cond;
         uint16_t threads;
         uint16_t waiting;
         uint64_t generation;
+
+        // spin barrier, the sense flips every time all threads arrived
+        _Atomic uint32_t arrived;
+        _Atomic uint32_t sense;
+        _Atomic uint32_t sleepers;
+        uint32_t spins;
     } synchronization;
+
+    // iterations of a repeated unit in the test process, decided by the first thread while the others wait
+    struct {
+        bool running;
+        uint64_t end_time;
+    } repeat;
+
+    struct {
+        int queue;
+    } wait;
+
+    // counters of the running test body, null while no body runs
+    struct {
+        winter_allocs_t* _Atomic counters;
+    } alloc;
+
+    // perf events of the test process, -1 if not opened
+    struct {
+        int fds[WINTER_COUNTER_LAST];
+    } counters;
 } winter_t;
 
 /// Global state, shared between threads and resources.
@@ -136,21 +576,111 @@ typedef struct {
     uint32_t linenum;
 
     uint16_t thread_id;
+
+    // random state of the delays before synchronize() with --jitter, seeded by every iteration
+    uint64_t jitter;
+
+    // test body the next call of the suite function jumps to
+    void* entry;
+
+    // unit running in the test process
+    const struct winter_unit* unit;
+
+    // property block running on the thread, its failures jump back to the block instead of exiting
+    winter_property_t* property;
 } winter_local_t;
 
 /// Thread local state, private to each thread.
 extern _Thread_local winter_local_t _winter_local;
 
-typedef struct {
-    double start_time;
+typedef struct winter_unit {
+    uint64_t start_time;
+    uint64_t end_time;
+    struct rusage usage;
+
+    // in milliseconds, the timeout of the test or the one derived from its history
+    double timeout;
+
+    int exit_code;
+    int signal;
+    bool timed_out;
+
+    // everything the test process printed, reported in one piece when the unit ends
+    winter_output_t* output;
+
+    // shared with the test process, null unless allocations are tracked
+    winter_allocs_t* allocs;
+
+    // shared with the test process, null unless benchmarks are saved or compared
+    winter_bench_stats_t* bench;
+
+    // shared with the test process, null without --counters
+    winter_counters_t* counters;
+
+    // shared with the test process, null unless the test is a property
+    winter_property_t* property;
+
+    // shared with the test process, null unless the unit is repeated
+    winter_repeat_t* repeat;
+
+    // shared with the test process, the records it wrote
+    winter_ring_t* ring;
 
     const winter_suite_t* suite;
     const winter_test_t* test;
 } winter_unit_t;
 
+/// Result of a unit of a batch, the usage holds the usage of the process when the unit started until it passed.
+typedef struct {
+    uint64_t start_time;
+    uint64_t end_time;
+    struct rusage usage;
+
+    // offset in the output file of the batch process after the unit
+    off_t output_end;
+} winter_batch_result_t;
+
+/// Progress of a batch process, shared with the runner. The units before finished passed, if the process dies the unit
+/// at finished is the one it died in.
+typedef struct {
+    _Atomic uint32_t started;
+    _Atomic uint32_t finished;
+    winter_batch_result_t results[WINTER_BATCH_SIZE];
+} winter_batch_shared_t;
+
+/// Consecutive units of a suite run one after another by one process with --batch. The runner forks a new process for
+/// the units after the one a process died in.
+typedef struct {
+    winter_unit_t units[WINTER_BATCH_SIZE];
+    uint32_t count;
+
+    // first unit of the running process and first unit that has not been reported
+    uint32_t first;
+    uint32_t reported;
+
+    // output of the running process, the units have their part of it
+    FILE* output;
+    winter_batch_shared_t* shared;
+} winter_batch_t;
+
+typedef struct {
+    winter_unit_t unit;
+    pid_t pid;
+
+    // pidfd on Linux, zero on Darwin if the process is registered with the kqueue, -1 if it needs to be polled
+    int fd;
+
+    // null unless units run in batches, the unit of the job is then the running unit of the batch
+    winter_batch_t* batch;
+
+    // null unless the case of a property crashed the process of the unit, the process then replays its choices
+    winter_unit_t* crashed;
+} winter_job_t;
+
 typedef struct {
     winter_unit_t* unit;
     uint16_t thread_id;
+    int cpu;
 } winter_args_t;
 
 typedef struct {
@@ -217,24 +747,140 @@ _winter_initialize(void) {
 
     _winter.initialized = true;
     _winter_array_init(&_winter.suites, sizeof(winter_suite_t));
-    _winter_array_init(&_winter.patterns, sizeof(const char*));
+    _winter_array_init(&_winter.patterns, sizeof(winter_pattern_t*));
+    _winter_array_init(&_winter.baselines, sizeof(winter_baseline_t));
     _winter.print.file = stderr;
     pthread_mutex_init(&_winter.print.mutex, nullptr);
+    _winter.wait.queue = -1;
+}
+
+#if defined(__APPLE__)
+extern const winter_suite_descriptor_t* const _winter_suites_start[] __asm("section$start$__DATA$winter_suites");
+extern const winter_suite_descriptor_t* const _winter_suites_stop[] __asm("section$end$__DATA$winter_suites");
+extern const winter_test_t* const _winter_tests_start[] __asm("section$start$__DATA$winter_tests");
+extern const winter_test_t* const _winter_tests_stop[] __asm("section$end$__DATA$winter_tests");
+#else
+// defined by the linker for sections named like identifiers, weak so binaries without tests link as well
+extern const winter_suite_descriptor_t* const __start_winter_suites[] __attribute__((weak));
+extern const winter_suite_descriptor_t* const __stop_winter_suites[] __attribute__((weak));
+extern const winter_test_t* const __start_winter_tests[] __attribute__((weak));
+extern const winter_test_t* const __stop_winter_tests[] __attribute__((weak));
+
+#define _winter_suites_start __start_winter_suites
+#define _winter_suites_stop __stop_winter_suites
+#define _winter_tests_start __start_winter_tests
+#define _winter_tests_stop __stop_winter_tests
+#endif
+
+WINTER_FUNC int
+_winter_test_compare(const void* a, const void* b) {
+    const uint64_t x = ((const winter_test_t*)a)->id;
+    const uint64_t y = ((const winter_test_t*)b)->id;
+
+    return (x > y) - (x < y);
+}
+
+/// Whether the test is in the suite function. The linker places the tests of a suite next to each other, so this is
+/// usually true for the suite of the test before.
+WINTER_FUNC bool
+_winter_is_test_in(const winter_suite_t* suite, const winter_test_t* test) {
+    return strcmp(suite->function, test->function) == 0 && strcmp(suite->file, test->file) == 0;
+}
+
+/// Collects the suites and tests registered in the linker sections. Files keep the link order, the suites of a file
+/// and the tests of a suite are sorted into the order in which they are declared.
+WINTER_FUNC void
+_winter_suites_load(void) {
+    for (const winter_suite_descriptor_t* const* it = _winter_suites_start; it < _winter_suites_stop; ++it) {
+        winter_suite_t suite = {
+            .name = (*it)->name,
+            .function = (*it)->function,
+            .file = (*it)->file,
+            .line = (*it)->line,
+            .func = (*it)->func,
+        };
+        _winter_array_init(&suite.tests, sizeof(winter_test_t));
+        _winter_array_push(&_winter.suites, &suite);
+
+        // the compiler may emit the suites of a file in any order, but they are next to each other in the section
+        for (size_t i = _winter.suites.length - 1; i > 0; --i) {
+            winter_suite_t* previous = _winter_array_get(&_winter.suites, i - 1);
+            winter_suite_t* current = _winter_array_get(&_winter.suites, i);
+            if (strcmp(previous->file, current->file) != 0 || previous->line < current->line) {
+                break;
+            }
+
+            const winter_suite_t swap = *previous;
+            *previous = *current;
+            *current = swap;
+        }
+    }
+
+    winter_suite_t* suite = nullptr;
+    for (const winter_test_t* const* it = _winter_tests_start; it < _winter_tests_stop; ++it) {
+        const winter_test_t* test = *it;
+
+        for (size_t i = 0; suite == nullptr || !_winter_is_test_in(suite, test); ++i) {
+            if (i == _winter.suites.length) {
+                _winter_fatal_error("No suite for test %s in %s", test->name, test->file);
+            }
+            suite = _winter_array_get(&_winter.suites, i);
+        }
+
+        _winter_array_push(&suite->tests, test);
+    }
+
+    for (size_t i = 0; i < _winter.suites.length; ++i) {
+        winter_suite_t* each = _winter_array_get(&_winter.suites, i);
+        qsort(each->tests.elements, each->tests.length, sizeof(winter_test_t), _winter_test_compare);
+    }
 }
 
 #define _winter_print(...) fprintf(_winter.print.file, __VA_ARGS__)
 
+/// Prints a message about a unit, which goes into the captured output of the unit if there is one.
+#define _winter_unit_print(unit, ...) _winter_output_printf((unit)->output, __VA_ARGS__)
+
 #define _winter_stringify_(a) #a
 #define _winter_stringify(a) _winter_stringify_(a)
 
 // ### MAIN FUNCTION ##################################################################################################
 
-WINTER_FUNC double
+/// Monotonic time in nanoseconds.
+WINTER_FUNC uint64_t
 _winter_now(void) {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+WINTER_FUNC double
+_winter_elapsed_ms(const uint64_t start_time) {
+    return (double)(_winter_now() - start_time) / 1000000.0;
+}
+
+WINTER_FUNC uint64_t
+_winter_splitmix(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+WINTER_FUNC uint64_t
+_winter_timeval_ns(const struct timeval tv) {
+    return (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_usec * 1000ULL;
+}
 
-    return (double)tv.tv_sec * 1000.0 + (double)tv.tv_usec / 1000.0;
+/// Peak resident set size in bytes, Linux reports it in kilobytes and Darwin in bytes.
+WINTER_FUNC uint64_t
+_winter_rss_bytes(const struct rusage* usage) {
+#if defined(__APPLE__)
+    return (uint64_t)usage->ru_maxrss;
+#else
+    return (uint64_t)usage->ru_maxrss * 1024;
+#endif
 }
 
 WINTER_FUNC void
@@ -249,514 +895,4078 @@ _winter_sleep_ms(uint32_t ms) {
     }
 }
 
-WINTER_FUNC void
-_winter_print_timer(const double start_time) {
-    double msec = _winter_now() - start_time;
-    if (msec < 0) {
-        msec = 0;
-    }
-
-    if (msec < 1) {
-        _winter_print("(%.02fµs)", msec * 1000);
-    } else if (msec < 1000) {
-        _winter_print("(%.02fms)", msec);
+/// Scales nanoseconds to the largest unit that is not larger than the value.
+WINTER_FUNC double
+_winter_ns_scaled(const double ns, const char** suffix) {
+    if (ns < 1000) {
+        *suffix = "ns";
+        return ns;
+    } else if (ns < 1000000) {
+        *suffix = "µs";
+        return ns / 1000;
+    } else if (ns < 1000000000) {
+        *suffix = "ms";
+        return ns / 1000000;
     } else {
-        _winter_print("(%.02fs)", msec / 1000);
+        *suffix = "s";
+        return ns / 1000000000;
     }
 }
 
 WINTER_FUNC void
-_winter_print_unit_begin(const winter_unit_t* unit) {
-    _winter_print(
-      "" WINTER_COLOR_BOLD WINTER_COLOR_MAYBE "? " WINTER_COLOR_RESET WINTER_COLOR_MAYBE
-      "Testing: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET "\n",
-      unit->test->name
-    );
-}
-
-WINTER_FUNC void
-_winter_print_unit_debug(const winter_unit_t* unit) {
-    _winter_print(
-      "" WINTER_COLOR_BOLD WINTER_COLOR_FAIL "> " WINTER_COLOR_RESET WINTER_COLOR_FAIL
-      "Running: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET "\n",
-      unit->test->name
-    );
+_winter_print_ns(const double ns) {
+    const char* suffix;
+    const double value = _winter_ns_scaled(ns, &suffix);
+    _winter_print("%.02f%s", value, suffix);
 }
 
 WINTER_FUNC void
-_winter_print_unit_end(const winter_unit_t* unit, const bool success) {
-    if (success) {
-        _winter_print(
-          "" WINTER_COLOR_BOLD WINTER_COLOR_SUCCESS "✓ " WINTER_COLOR_RESET WINTER_COLOR_SUCCESS
-          "Success: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET " ",
-          unit->test->name
-        );
+_winter_print_bytes(const double bytes) {
+    if (bytes < 1024) {
+        _winter_print("%.0fB", bytes);
+    } else if (bytes < 1024 * 1024) {
+        _winter_print("%.02fKB", bytes / 1024);
+    } else if (bytes < 1024 * 1024 * 1024) {
+        _winter_print("%.02fMB", bytes / (1024 * 1024));
     } else {
-        _winter_print(
-          "" WINTER_COLOR_BOLD WINTER_COLOR_FAIL "✕ " WINTER_COLOR_RESET WINTER_COLOR_FAIL
-          "Failure: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET " ",
-          unit->test->name
-        );
+        _winter_print("%.02fGB", bytes / (1024 * 1024 * 1024));
     }
-
-    _winter_print_timer(unit->start_time);
-    _winter_print("\n");
 }
 
+/// Prints a count with a metric suffix.
 WINTER_FUNC void
-_winter_print_suite_begin(const winter_suite_t* suite) {
-    _winter_print("\n" WINTER_COLOR_BOLD "Testing suite %s" WINTER_COLOR_RESET ":\n", suite->name);
+_winter_print_count(const double count) {
+    if (count < 1000) {
+        _winter_print("%.0f", count);
+    } else if (count < 1000000) {
+        _winter_print("%.02fk", count / 1000);
+    } else if (count < 1000000000) {
+        _winter_print("%.02fM", count / 1000000);
+    } else {
+        _winter_print("%.02fG", count / 1000000000);
+    }
 }
 
-WINTER_FUNC void
-_winter_print_suite_end(const winter_suite_t* suite, const uint32_t test_count, const uint32_t success_count) {
-    _winter_print(
-      WINTER_COLOR_BOLD "Suite %s: Passed %i/%i tests.\n" WINTER_COLOR_RESET, suite->name, success_count, test_count
-    );
+WINTER_FUNC const char*
+_winter_counter_name(const winter_counter_t counter) {
+    switch (counter) {
+    case WINTER_COUNTER_CYCLES:
+        return "cycles";
+    case WINTER_COUNTER_INSTRUCTIONS:
+        return "instructions";
+    case WINTER_COUNTER_L1_MISSES:
+        return "L1 misses";
+    case WINTER_COUNTER_LLC_MISSES:
+        return "LLC misses";
+    case WINTER_COUNTER_BRANCH_MISSES:
+        return "branch misses";
+    default:
+        return "unknown";
+    }
 }
 
+/// Prints the available hardware counters divided by the number of iterations, with the IPC after the instructions.
 WINTER_FUNC void
-_winter_print_summary(const double start_time, const uint32_t success_count, const uint32_t test_count) {
-    _winter_print(WINTER_COLOR_BOLD "\nTotal: Passed %i/%i tests. " WINTER_COLOR_RESET, success_count, test_count);
-    _winter_print_timer(start_time);
-    _winter_print("\n");
-}
+_winter_print_counters(const winter_counters_t* counters, const double iterations) {
+    const char* separator = "";
 
-WINTER_FUNC void*
-_winter_thread_entry(void* void_args) {
-    const winter_args_t* args = void_args;
-    _winter_local.thread_id = args->thread_id;
-    args->unit->suite->func(args->unit->test->id, nullptr);
-    return nullptr;
-}
-
-WINTER_FUNC void
-_winter_thread_syncronize(void) {
-    pthread_mutex_lock(&_winter.synchronization.mutex);
+    for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+        if (!counters->available[i]) {
+            continue;
+        }
 
-    const uint64_t generation = _winter.synchronization.generation;
+        _winter_print("%s%s ", separator, _winter_counter_name((winter_counter_t)i));
+        _winter_print_count((double)counters->values[i] / iterations);
+        separator = ", ";
 
-    if (++_winter.synchronization.waiting == _winter.synchronization.threads) {
-        _winter.synchronization.waiting = 0;
-        _winter.synchronization.generation += 1;
-        pthread_cond_broadcast(&_winter.synchronization.cond);
-    } else {
-        while (_winter.synchronization.generation == generation) {
-            pthread_cond_wait(&_winter.synchronization.cond, &_winter.synchronization.mutex);
+        const uint64_t cycles = counters->values[WINTER_COUNTER_CYCLES];
+        if (i == WINTER_COUNTER_INSTRUCTIONS && counters->available[WINTER_COUNTER_CYCLES] && cycles != 0) {
+            _winter_print(", IPC %.02f", (double)counters->values[i] / (double)cycles);
         }
     }
-    pthread_mutex_unlock(&_winter.synchronization.mutex);
 }
 
+/// Prints the wall time and, if the resource usage of the process is known, its CPU time, peak memory, minor/major
+/// page faults and voluntary/involuntary context switches, followed by the allocations and hardware counters if they
+/// were recorded.
 WINTER_FUNC void
-_winter_process_entry(winter_unit_t* unit) {
-    unit->suite->func(WINTER_FUNC_BEFORE_EACH, nullptr);
-
-    pthread_mutex_init(&_winter.synchronization.mutex, nullptr);
-    pthread_cond_init(&_winter.synchronization.cond, nullptr);
-    _winter.synchronization.waiting = 0;
-    _winter.synchronization.threads = unit->test->threads;
-    _winter.synchronization.generation = 0;
-
-    if (unit->test->threads == 1) {
-        _winter_local.thread_id = 0;
-        unit->suite->func(unit->test->id, nullptr);
-    } else {
-        pthread_t threads[unit->test->threads];
-        winter_args_t args[unit->test->threads];
+_winter_print_timer(
+  const uint64_t elapsed,
+  const struct rusage* usage,
+  const winter_allocs_t* allocs,
+  const winter_counters_t* counters
+) {
+    _winter_print("(");
+    _winter_print_ns((double)elapsed);
+
+    if (usage != nullptr) {
+        _winter_print(", user ");
+        _winter_print_ns((double)_winter_timeval_ns(usage->ru_utime));
+        _winter_print(", sys ");
+        _winter_print_ns((double)_winter_timeval_ns(usage->ru_stime));
+        _winter_print(", rss ");
+        _winter_print_bytes((double)_winter_rss_bytes(usage));
+        _winter_print(", faults %ld/%ld", usage->ru_minflt, usage->ru_majflt);
+        _winter_print(", switches %ld/%ld", usage->ru_nvcsw, usage->ru_nivcsw);
+    }
 
-        for (uint16_t i = 0; i < unit->test->threads; ++i) {
-            args[i] = (winter_args_t){
-                .unit = unit,
-                .thread_id = i,
-            };
+    if (allocs != nullptr && allocs->available) {
+        _winter_print(", allocs %ju/", (uintmax_t)allocs->allocs);
+        _winter_print_bytes((double)allocs->bytes);
+        _winter_print(", leaked %ju", (uintmax_t)(allocs->allocs > allocs->frees ? allocs->allocs - allocs->frees : 0));
+    }
 
-            if (pthread_create(&threads[i], nullptr, _winter_thread_entry, &args[i]) != 0) {
-                _winter_print(WINTER_INDENT "Failed to create thread (%s).\n", strerror(errno));
-                _exit(WINTER_EXIT_FAILURE);
-            }
-        }
-        for (uint16_t i = 0; i < unit->test->threads; ++i) {
-            if (pthread_join(threads[i], nullptr)) {
-                _winter_print(WINTER_INDENT "Failed to join thread (%s).\n", strerror(errno));
-                _exit(WINTER_EXIT_FAILURE);
+    if (counters != nullptr) {
+        for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+            if (counters->available[i]) {
+                _winter_print(", ");
+                _winter_print_counters(counters, 1);
+                break;
             }
         }
     }
 
-    unit->suite->func(WINTER_FUNC_AFTER_EACH, nullptr);
+    _winter_print(")");
 }
 
-static volatile sig_atomic_t _winter_debug_abort = false;
+// ### ALLOCATIONS ####################################################################################################
 
-WINTER_FUNC void
-_winter_debug_handler(const int sig) {
-    (void)sig;
-    _winter_debug_abort = true;
+// allocations are counted when WINTER_ALLOC_TRACKING is defined. On Linux the binary also has to be linked with
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free so the allocator calls go through the wrappers below,
+// Darwin needs no flags since allocations are reported through malloc_logger. make ALLOC_TRACKING=1 sets up both
+// through module.mk
+
+WINTER_FUNC size_t
+_winter_alloc_size(void* ptr) {
+#if defined(WINTER_ALLOC_TRACKING) && defined(__linux__)
+    return malloc_usable_size(ptr);
+#elif defined(WINTER_ALLOC_TRACKING) && defined(__APPLE__)
+    return malloc_size(ptr);
+#else
+    (void)ptr;
+    return 0;
+#endif
 }
 
 WINTER_FUNC void
-_winter_kill_process(const pid_t pid) {
-    if (kill(pid, SIGCONT) == -1) {
-        _winter_print(WINTER_INDENT "Failed to continue process (%s).\n", strerror(errno));
+_winter_alloc_record(void* ptr) {
+    winter_allocs_t* counters = atomic_load_explicit(&_winter.alloc.counters, memory_order_relaxed);
+    if (counters == nullptr || ptr == nullptr) {
         return;
     }
 
-    if (kill(pid, SIGKILL) == -1) {
-        _winter_print(WINTER_INDENT "Failed to kill process (%s).\n", strerror(errno));
-        return;
+    atomic_fetch_add_explicit(&counters->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->bytes, _winter_alloc_size(ptr), memory_order_relaxed);
+}
+
+WINTER_FUNC void
+_winter_free_record(void* ptr) {
+    winter_allocs_t* counters = atomic_load_explicit(&_winter.alloc.counters, memory_order_relaxed);
+    if (counters == nullptr || ptr == nullptr) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&counters->frees, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->freed_bytes, _winter_alloc_size(ptr), memory_order_relaxed);
+}
+
+#if defined(WINTER_ALLOC_TRACKING) && defined(__APPLE__)
+// called by libmalloc for every allocation and before every free while it is set
+extern void (*malloc_logger)(uint32_t, uintptr_t, uintptr_t, uintptr_t, uintptr_t, uint32_t);
+
+WINTER_FUNC void
+_winter_malloc_logger(
+  const uint32_t type,
+  const uintptr_t zone,
+  const uintptr_t arg,
+  const uintptr_t size,
+  const uintptr_t result,
+  const uint32_t skip
+) {
+    (void)zone;
+    (void)size;
+    (void)skip;
+
+    // 2 is an allocation and 4 a deallocation, a reallocation is both with the old block in arg
+    if (type & 4) {
+        _winter_free_record((void*)arg);
+    }
+    if (type & 2) {
+        _winter_alloc_record((void*)result);
+    }
+}
+#endif
+
+/// Starts counting the allocations of the test body into the shared counters. Tracking is only available if the
+/// allocator calls are interposed, which is probed with one allocation.
+WINTER_FUNC void
+_winter_alloc_begin(winter_allocs_t* counters) {
+    if (counters == nullptr) {
+        return;
+    }
+
+    *counters = (winter_allocs_t){ 0 };
+    atomic_store(&_winter.alloc.counters, counters);
+#if defined(WINTER_ALLOC_TRACKING) && defined(__APPLE__)
+    malloc_logger = _winter_malloc_logger;
+#endif
+
+    void* volatile probe = malloc(1);
+    free(probe);
+
+    counters->available = atomic_load(&counters->allocs) != 0;
+    *counters = (winter_allocs_t){ .available = counters->available };
+}
+
+WINTER_FUNC void
+_winter_alloc_end(void) {
+#if defined(WINTER_ALLOC_TRACKING) && defined(__APPLE__)
+    malloc_logger = nullptr;
+#endif
+    atomic_store(&_winter.alloc.counters, nullptr);
+}
+
+/// Maps zeroed memory that stays shared with the test processes forked after it.
+WINTER_FUNC void*
+_winter_shared_map(const size_t size) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    if (memory == MAP_FAILED) {
+        _winter_fatal_error("Failed to map shared memory (%s)", strerror(errno));
+    }
+
+    return memory;
+}
+
+WINTER_FUNC void
+_winter_shared_unmap(void* memory, const size_t size) {
+    if (memory != nullptr) {
+        munmap(memory, size);
+    }
+}
+
+/// Maps the counters of a unit so the runner sees what the test process counted, or returns null without tracking.
+WINTER_FUNC winter_allocs_t*
+_winter_alloc_map(void) {
+#ifdef WINTER_ALLOC_TRACKING
+    return _winter_shared_map(sizeof(winter_allocs_t));
+#else
+    return nullptr;
+#endif
+}
+
+// ### RECORDS ########################################################################################################
+
+/// Writes a record into the ring of the unit running on the thread, without any system call. Does nothing outside of
+/// a test process.
+WINTER_FUNC void
+_winter_record(const winter_record_t* record) {
+    const winter_unit_t* unit = _winter_local.unit;
+    if (unit == nullptr || unit->ring == nullptr) {
+        return;
+    }
+
+    winter_ring_t* ring = unit->ring;
+    const uint32_t index = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    const uint32_t slot = index % WINTER_RECORDS;
+
+    ring->records[slot] = *record;
+    ring->records[slot].time = _winter_now();
+    atomic_store_explicit(&ring->sequences[slot], index + 1, memory_order_release);
+}
+
+/// Records the location of the failed assertion. Failures of the cases a property generates or shrinks jump back into
+/// the property, only the one it ends with is recorded.
+WINTER_FUNC void
+_winter_record_failure(const char* file, const uint32_t line) {
+    const winter_property_t* property = _winter_local.property;
+    if (property != nullptr && property->running && property->phase != _WINTER_PROPERTY_FINAL &&
+        property->phase != _WINTER_PROPERTY_REPLAY) {
+        return;
+    }
+
+    _winter_record(&(winter_record_t){ .kind = WINTER_RECORD_FAILURE, .failure = { .file = file, .line = line } });
+}
+
+WINTER_FUNC void
+_winter_record_metric(const char* name, const double value) {
+    _winter_record(&(winter_record_t){ .kind = WINTER_RECORD_METRIC, .metric = { .name = name, .value = value } });
+}
+
+/// Returns the complete records of a unit after its process ended, oldest first, or null after the last one. The
+/// cursor starts at zero.
+WINTER_FUNC const winter_record_t*
+_winter_record_next(const winter_unit_t* unit, uint32_t* cursor) {
+    const winter_ring_t* ring = unit->ring;
+    if (ring == nullptr) {
+        return nullptr;
+    }
+
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t index = head > WINTER_RECORDS && *cursor < head - WINTER_RECORDS ? head - WINTER_RECORDS : *cursor;
+
+    for (; index < head; ++index) {
+        const uint32_t slot = index % WINTER_RECORDS;
+        if (atomic_load_explicit(&ring->sequences[slot], memory_order_acquire) == index + 1) {
+            *cursor = index + 1;
+            return &ring->records[slot];
+        }
+    }
+
+    *cursor = head;
+    return nullptr;
+}
+
+/// Returns the last record of the kind, or null if the unit wrote none.
+WINTER_FUNC const winter_record_t*
+_winter_record_last(const winter_unit_t* unit, const winter_record_kind_t kind) {
+    const winter_record_t* last = nullptr;
+
+    uint32_t cursor = 0;
+    for (const winter_record_t* record; (record = _winter_record_next(unit, &cursor)) != nullptr;) {
+        if (record->kind == kind) {
+            last = record;
+        }
+    }
+
+    return last;
+}
+
+// ### COUNTERS #######################################################################################################
+
+/// Opens the perf events of the test process, inherited by the threads it creates. Events that can not be opened
+/// because of permissions or missing hardware support are left out.
+WINTER_FUNC void
+_winter_counters_begin(winter_counters_t* counters) {
+    for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+        _winter.counters.fds[i] = -1;
+    }
+
+    if (counters == nullptr) {
+        return;
+    }
+    *counters = (winter_counters_t){ 0 };
+
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[WINTER_COUNTER_LAST] = {
+        [WINTER_COUNTER_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        [WINTER_COUNTER_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        [WINTER_COUNTER_L1_MISSES] = {
+            PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        },
+        [WINTER_COUNTER_LLC_MISSES] = {
+            PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        },
+        [WINTER_COUNTER_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+
+    for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+        struct perf_event_attr attr = {
+            .type = events[i].type,
+            .size = sizeof(struct perf_event_attr),
+            .config = events[i].config,
+            .read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+            .disabled = 1,
+            .inherit = 1,
+            .exclude_kernel = 1,
+            .exclude_hv = 1,
+        };
+
+        _winter.counters.fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        counters->available[i] = _winter.counters.fds[i] >= 0;
+    }
+
+    for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+        if (_winter.counters.fds[i] >= 0) {
+            ioctl(_winter.counters.fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+/// Reads the counters without stopping them.
+WINTER_FUNC void
+_winter_counters_read(winter_counter_read_t* reads) {
+    for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+        reads[i] = (winter_counter_read_t){ 0 };
+        if (_winter.counters.fds[i] >= 0 && read(_winter.counters.fds[i], &reads[i], sizeof(reads[i])) < 0) {
+            reads[i] = (winter_counter_read_t){ 0 };
+        }
+    }
+}
+
+/// Stores the counts between two readings into the counters.
+WINTER_FUNC void
+_winter_counters_delta(
+  winter_counters_t* counters,
+  const winter_counter_read_t* start,
+  const winter_counter_read_t* end
+) {
+    for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+        const uint64_t value = end[i].value - start[i].value;
+        const uint64_t enabled = end[i].enabled - start[i].enabled;
+        const uint64_t running = end[i].running - start[i].running;
+
+        counters->available[i] = _winter.counters.fds[i] >= 0 && running != 0;
+        counters->values[i] = running != 0 ? (uint64_t)((double)value * (double)enabled / (double)running) : 0;
+    }
+}
+
+WINTER_FUNC void
+_winter_counters_end(winter_counters_t* counters) {
+    if (counters == nullptr) {
+        return;
+    }
+
+    const winter_counter_read_t start[WINTER_COUNTER_LAST] = { 0 };
+    winter_counter_read_t end[WINTER_COUNTER_LAST];
+    _winter_counters_read(end);
+    _winter_counters_delta(counters, start, end);
+
+    for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+        if (_winter.counters.fds[i] >= 0) {
+            close(_winter.counters.fds[i]);
+            _winter.counters.fds[i] = -1;
+        }
+    }
+}
+
+// ### OUTPUT CAPTURE #################################################################################################
+
+WINTER_FUNC void
+_winter_output_append(winter_output_t* output, const char* data, const size_t length) {
+    if (output->spill == nullptr && output->length + length > WINTER_OUTPUT_MEMORY_MAX) {
+        output->spill = tmpfile();
+        if (output->spill == nullptr) {
+            _winter_fatal_error("Failed to create a file for test output (%s)", strerror(errno));
+        }
+
+        fwrite(output->data, 1, output->length, output->spill);
+        free(output->data);
+        output->data = nullptr;
+        output->length = 0;
+        output->capacity = 0;
+    }
+
+    if (output->spill != nullptr) {
+        fwrite(data, 1, length, output->spill);
+        return;
+    }
+
+    if (output->length + length > output->capacity) {
+        size_t capacity = output->capacity != 0 ? output->capacity : 4096;
+        while (capacity < output->length + length) {
+            capacity *= 2;
+        }
+
+        output->data = realloc(output->data, capacity);
+        if (output->data == nullptr) {
+            _winter_fatal_error("Output buffer reallocation failed (size: %zu)", capacity);
+        }
+        output->capacity = capacity;
+    }
+
+    memcpy(output->data + output->length, data, length);
+    output->length += length;
+}
+
+WINTER_FUNC __attribute__((__format__(__printf__, 2, 3))) void
+_winter_output_printf(winter_output_t* output, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    if (output == nullptr) {
+        vfprintf(_winter.print.file, fmt, args);
+    } else {
+        char buffer[1024];
+        const int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+        if (length > 0) {
+            const size_t written = (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1;
+            _winter_output_append(output, buffer, written);
+        }
+    }
+
+    va_end(args);
+}
+
+/// Creates an empty output that is filled by the runner, without a pipe.
+WINTER_FUNC winter_output_t*
+_winter_output_create(void) {
+    winter_output_t* output = calloc(1, sizeof(winter_output_t));
+    if (output == nullptr) {
+        _winter_fatal_error("Output allocation failed");
+    }
+
+    output->fd = -1;
+    return output;
+}
+
+/// Creates the pipe of a unit, the write end is returned for the test process.
+WINTER_FUNC winter_output_t*
+_winter_output_open(int* write_fd) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        _winter_fatal_error("Failed to create a pipe for test output (%s)", strerror(errno));
+    }
+
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+    winter_output_t* output = _winter_output_create();
+    output->fd = fds[0];
+    *write_fd = fds[1];
+    return output;
+}
+
+/// Reads everything the test process wrote so far without blocking, so it never blocks on a full pipe. The pipe is
+/// closed when the last writer closed it.
+WINTER_FUNC void
+_winter_output_drain(winter_output_t* output) {
+    if (output == nullptr || output->fd < 0) {
+        return;
+    }
+
+    char buffer[16384];
+    while (true) {
+        const ssize_t length = read(output->fd, buffer, sizeof(buffer));
+        if (length > 0) {
+            _winter_output_append(output, buffer, (size_t)length);
+            continue;
+        }
+        if (length == -1 && errno == EINTR) {
+            continue;
+        }
+        if (length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            close(output->fd);
+            output->fd = -1;
+        }
+        return;
+    }
+}
+
+WINTER_FUNC void
+_winter_output_close(winter_output_t* output) {
+    if (output == nullptr) {
+        return;
+    }
+
+    if (output->fd >= 0) {
+        close(output->fd);
+    }
+    if (output->spill != nullptr) {
+        fclose(output->spill);
+    }
+
+    free(output->data);
+    free(output);
+}
+
+/// Streams the captured output of a unit through the escape function if there is one, without loading all of it into
+/// memory.
+WINTER_FUNC void
+_winter_print_output(const winter_unit_t* unit, void (*escape)(char)) {
+    const winter_output_t* output = unit->output;
+    if (output == nullptr) {
+        return;
+    }
+
+    char buffer[4096];
+    const char* data = output->data;
+    size_t length = output->length;
+
+    if (output->spill != nullptr) {
+        if (fseek(output->spill, 0, SEEK_SET) != 0) {
+            return;
+        }
+        data = buffer;
+        length = fread(buffer, 1, sizeof(buffer), output->spill);
+    }
+
+    while (length > 0) {
+        if (escape == nullptr) {
+            fwrite(data, 1, length, _winter.print.file);
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                escape(data[i]);
+            }
+        }
+
+        length = output->spill != nullptr ? fread(buffer, 1, sizeof(buffer), output->spill) : 0;
+    }
+}
+
+// ### REPORTERS ######################################################################################################
+
+WINTER_FUNC void
+_winter_text_unit_begin(const winter_unit_t* unit) {
+    _winter_print(
+      "" WINTER_COLOR_BOLD WINTER_COLOR_MAYBE "? " WINTER_COLOR_RESET WINTER_COLOR_MAYBE
+      "Testing: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET "\n",
+      unit->test->name
+    );
+}
+
+WINTER_FUNC void
+_winter_text_unit_end(const winter_unit_t* unit, const bool success) {
+    // with concurrent jobs or batches the start line is printed here, so the lines of a unit stay together
+    if (_winter.opts.jobs > 1 || _winter.opts.batch) {
+        _winter_text_unit_begin(unit);
+    }
+    _winter_print_output(unit, nullptr);
+
+    if (success) {
+        _winter_print(
+          "" WINTER_COLOR_BOLD WINTER_COLOR_SUCCESS "✓ " WINTER_COLOR_RESET WINTER_COLOR_SUCCESS
+          "Success: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET " ",
+          unit->test->name
+        );
+    } else {
+        _winter_print(
+          "" WINTER_COLOR_BOLD WINTER_COLOR_FAIL "✕ " WINTER_COLOR_RESET WINTER_COLOR_FAIL
+          "Failure: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET " ",
+          unit->test->name
+        );
+    }
+
+    _winter_print_timer(unit->end_time - unit->start_time, &unit->usage, unit->allocs, unit->counters);
+    _winter_print("\n");
+
+    uint32_t cursor = 0;
+    for (const winter_record_t* record; (record = _winter_record_next(unit, &cursor)) != nullptr;) {
+        if (record->kind == WINTER_RECORD_METRIC) {
+            _winter_print(WINTER_INDENT "%s: %g\n", record->metric.name, record->metric.value);
+        }
+    }
+}
+
+WINTER_FUNC void
+_winter_text_suite_begin(const winter_suite_t* suite) {
+    _winter_print("\n" WINTER_COLOR_BOLD "Testing suite %s" WINTER_COLOR_RESET ":\n", suite->name);
+}
+
+WINTER_FUNC void
+_winter_text_suite_end(const winter_suite_t* suite, const uint32_t test_count, const uint32_t success_count) {
+    _winter_print(
+      WINTER_COLOR_BOLD "Suite %s: Passed %i/%i tests.\n" WINTER_COLOR_RESET, suite->name, success_count, test_count
+    );
+}
+
+WINTER_FUNC void
+_winter_text_summary(const uint64_t start_time, const uint32_t success_count, const uint32_t test_count) {
+    _winter_print(WINTER_COLOR_BOLD "\nTotal: Passed %i/%i tests. " WINTER_COLOR_RESET, success_count, test_count);
+    _winter_print_timer(_winter_now() - start_time, nullptr, nullptr, nullptr);
+    _winter_print("\n");
+}
+
+/// Short description of why a unit failed, used by the machine readable reporters.
+WINTER_FUNC const char*
+_winter_unit_reason(const winter_unit_t* unit) {
+    if (unit->timed_out) {
+        return "timeout";
+    }
+    if (unit->signal != 0) {
+        return "signal";
+    }
+    if (unit->exit_code == WINTER_EXIT_FAILURE) {
+        return "assertion";
+    }
+    if (unit->exit_code != 0) {
+        return "exit";
+    }
+
+    return "budget";
+}
+
+WINTER_FUNC void
+_winter_json_char(const char c) {
+    switch (c) {
+    case '"':
+        _winter_print("\\\"");
+        break;
+    case '\\':
+        _winter_print("\\\\");
+        break;
+    case '\n':
+        _winter_print("\\n");
+        break;
+    case '\r':
+        _winter_print("\\r");
+        break;
+    case '\t':
+        _winter_print("\\t");
+        break;
+    default:
+        if ((unsigned char)c < 0x20) {
+            _winter_print("\\u%04x", (unsigned char)c);
+        } else {
+            fputc(c, _winter.print.file);
+        }
+    }
+}
+
+WINTER_FUNC void
+_winter_json_string(const char* str) {
+    fputc('"', _winter.print.file);
+    for (; *str != '\0'; ++str) {
+        _winter_json_char(*str);
+    }
+    fputc('"', _winter.print.file);
+}
+
+WINTER_FUNC void
+_winter_xml_char(const char c) {
+    switch (c) {
+    case '"':
+        _winter_print("&quot;");
+        break;
+    case '&':
+        _winter_print("&amp;");
+        break;
+    case '<':
+        _winter_print("&lt;");
+        break;
+    case '>':
+        _winter_print("&gt;");
+        break;
+    default:
+        // control characters other than whitespace are not allowed in XML 1.0
+        if ((unsigned char)c >= 0x20 || c == '\n' || c == '\r' || c == '\t') {
+            fputc(c, _winter.print.file);
+        }
+    }
+}
+
+WINTER_FUNC void
+_winter_xml_string(const char* str) {
+    for (; *str != '\0'; ++str) {
+        _winter_xml_char(*str);
+    }
+}
+
+/// Prints the record of a unit as one line of json.
+WINTER_FUNC void
+_winter_json_unit_end(const winter_unit_t* unit, const bool success) {
+    _winter_print("{\"type\":\"unit\",\"suite\":");
+    _winter_json_string(unit->suite->name);
+    _winter_print(",\"test\":");
+    _winter_json_string(unit->test->name);
+    _winter_print(",\"success\":%s", success ? "true" : "false");
+    if (!success) {
+        _winter_print(",\"reason\":\"%s\"", _winter_unit_reason(unit));
+    }
+    _winter_print(",\"exit_code\":%d,\"signal\":%d", unit->exit_code, unit->signal);
+    _winter_print(
+      ",\"wall_ns\":%ju,\"user_ns\":%ju,\"system_ns\":%ju",
+      (uintmax_t)(unit->end_time - unit->start_time),
+      (uintmax_t)_winter_timeval_ns(unit->usage.ru_utime),
+      (uintmax_t)_winter_timeval_ns(unit->usage.ru_stime)
+    );
+    _winter_print(
+      ",\"max_rss\":%ju,\"minor_faults\":%ld,\"major_faults\":%ld,\"voluntary_switches\":%ld,"
+      "\"involuntary_switches\":%ld",
+      (uintmax_t)_winter_rss_bytes(&unit->usage),
+      unit->usage.ru_minflt,
+      unit->usage.ru_majflt,
+      unit->usage.ru_nvcsw,
+      unit->usage.ru_nivcsw
+    );
+    for (int i = 0; unit->counters != nullptr && i < WINTER_COUNTER_LAST; ++i) {
+        if (unit->counters->available[i]) {
+            static const char* const keys[WINTER_COUNTER_LAST] = {
+                "cycles", "instructions", "l1_misses", "llc_misses", "branch_misses",
+            };
+            _winter_print(",\"%s\":%ju", keys[i], (uintmax_t)unit->counters->values[i]);
+        }
+    }
+    if (unit->allocs != nullptr && unit->allocs->available) {
+        _winter_print(
+          ",\"allocs\":%ju,\"alloc_bytes\":%ju,\"frees\":%ju",
+          (uintmax_t)unit->allocs->allocs,
+          (uintmax_t)unit->allocs->bytes,
+          (uintmax_t)unit->allocs->frees
+        );
+    }
+
+    const winter_record_t* failure = _winter_record_last(unit, WINTER_RECORD_FAILURE);
+    if (!success && failure != nullptr) {
+        _winter_print(",\"file\":");
+        _winter_json_string(failure->failure.file);
+        _winter_print(",\"line\":%u", failure->failure.line);
+    }
+
+    _winter_print(",\"metrics\":[");
+    uint32_t cursor = 0;
+    bool first = true;
+    for (const winter_record_t* record; (record = _winter_record_next(unit, &cursor)) != nullptr;) {
+        if (record->kind != WINTER_RECORD_METRIC) {
+            continue;
+        }
+
+        _winter_print("%s{\"name\":", first ? "" : ",");
+        _winter_json_string(record->metric.name);
+        // json has no representation of infinities and nan
+        if (isfinite(record->metric.value)) {
+            _winter_print(",\"value\":%.17g}", record->metric.value);
+        } else {
+            _winter_print(",\"value\":null}");
+        }
+        first = false;
+    }
+    _winter_print("]");
+
+    _winter_print(",\"output\":\"");
+    _winter_print_output(unit, _winter_json_char);
+    _winter_print("\"}\n");
+}
+
+WINTER_FUNC void
+_winter_json_suite_end(const winter_suite_t* suite, const uint32_t test_count, const uint32_t success_count) {
+    _winter_print("{\"type\":\"suite\",\"suite\":");
+    _winter_json_string(suite->name);
+    _winter_print(",\"tests\":%u,\"passed\":%u}\n", test_count, success_count);
+}
+
+WINTER_FUNC void
+_winter_json_summary(const uint64_t start_time, const uint32_t success_count, const uint32_t test_count) {
+    _winter_print(
+      "{\"type\":\"summary\",\"tests\":%u,\"passed\":%u,\"wall_ns\":%ju}\n",
+      test_count,
+      success_count,
+      (uintmax_t)(_winter_now() - start_time)
+    );
+}
+
+WINTER_FUNC void
+_winter_junit_unit_end(const winter_unit_t* unit, const bool success) {
+    _winter_print(WINTER_INDENT WINTER_INDENT "<testcase classname=\"");
+    _winter_xml_string(unit->suite->name);
+    _winter_print("\" name=\"");
+    _winter_xml_string(unit->test->name);
+    _winter_print("\" time=\"%.06f\">\n", (double)(unit->end_time - unit->start_time) / 1000000000.0);
+
+    if (success) {
+        _winter_print(WINTER_INDENT WINTER_INDENT WINTER_INDENT "<system-out>");
+        _winter_print_output(unit, _winter_xml_char);
+        _winter_print("</system-out>\n");
+    } else {
+        _winter_print(
+          WINTER_INDENT WINTER_INDENT WINTER_INDENT "<failure type=\"%s\" message=\"exit code %d, signal %d",
+          _winter_unit_reason(unit),
+          unit->exit_code,
+          unit->signal
+        );
+
+        const winter_record_t* failure = _winter_record_last(unit, WINTER_RECORD_FAILURE);
+        if (failure != nullptr) {
+            _winter_print(", in ");
+            _winter_xml_string(failure->failure.file);
+            _winter_print(":%u", failure->failure.line);
+        }
+
+        _winter_print("\">");
+        _winter_print_output(unit, _winter_xml_char);
+        _winter_print("</failure>\n");
+    }
+
+    _winter_print(WINTER_INDENT WINTER_INDENT "</testcase>\n");
+}
+
+WINTER_FUNC void
+_winter_junit_suite_begin(const winter_suite_t* suite) {
+    _winter_print(WINTER_INDENT "<testsuite name=\"");
+    _winter_xml_string(suite->name);
+    _winter_print("\">\n");
+}
+
+WINTER_FUNC void
+_winter_junit_suite_end(void) {
+    _winter_print(WINTER_INDENT "</testsuite>\n");
+}
+
+WINTER_FUNC void
+_winter_print_header(void) {
+    if (_winter.opts.reporter == WINTER_REPORTER_JUNIT) {
+        _winter_print("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n");
+    }
+}
+
+WINTER_FUNC void
+_winter_print_unit_begin(const winter_unit_t* unit) {
+    if (_winter.opts.reporter == WINTER_REPORTER_TEXT && _winter.opts.jobs == 1 && !_winter.opts.batch) {
+        _winter_text_unit_begin(unit);
+        fflush(_winter.print.file);
+    }
+}
+
+WINTER_FUNC void
+_winter_print_unit_debug(const winter_unit_t* unit) {
+    _winter_print(
+      "" WINTER_COLOR_BOLD WINTER_COLOR_FAIL "> " WINTER_COLOR_RESET WINTER_COLOR_FAIL
+      "Running: " WINTER_COLOR_RESET WINTER_COLOR_DESC "%s" WINTER_COLOR_RESET "\n",
+      unit->test->name
+    );
+}
+
+WINTER_FUNC void
+_winter_print_unit_end(const winter_unit_t* unit, const bool success) {
+    switch (_winter.opts.reporter) {
+    case WINTER_REPORTER_TEXT:
+        _winter_text_unit_end(unit, success);
+        break;
+    case WINTER_REPORTER_JSON:
+        _winter_json_unit_end(unit, success);
+        break;
+    case WINTER_REPORTER_JUNIT:
+        _winter_junit_unit_end(unit, success);
+        break;
+    }
+
+    fflush(_winter.print.file);
+}
+
+WINTER_FUNC void
+_winter_print_suite_begin(const winter_suite_t* suite) {
+    switch (_winter.opts.reporter) {
+    case WINTER_REPORTER_TEXT:
+        _winter_text_suite_begin(suite);
+        break;
+    case WINTER_REPORTER_JSON:
+        break;
+    case WINTER_REPORTER_JUNIT:
+        _winter_junit_suite_begin(suite);
+        break;
+    }
+}
+
+WINTER_FUNC void
+_winter_print_suite_end(const winter_suite_t* suite, const uint32_t test_count, const uint32_t success_count) {
+    switch (_winter.opts.reporter) {
+    case WINTER_REPORTER_TEXT:
+        _winter_text_suite_end(suite, test_count, success_count);
+        break;
+    case WINTER_REPORTER_JSON:
+        _winter_json_suite_end(suite, test_count, success_count);
+        break;
+    case WINTER_REPORTER_JUNIT:
+        _winter_junit_suite_end();
+        break;
+    }
+
+    fflush(_winter.print.file);
+}
+
+WINTER_FUNC void
+_winter_print_summary(const uint64_t start_time, const uint32_t success_count, const uint32_t test_count) {
+    switch (_winter.opts.reporter) {
+    case WINTER_REPORTER_TEXT:
+        _winter_text_summary(start_time, success_count, test_count);
+        break;
+    case WINTER_REPORTER_JSON:
+        _winter_json_summary(start_time, success_count, test_count);
+        break;
+    case WINTER_REPORTER_JUNIT:
+        _winter_print("</testsuites>\n");
+        break;
+    }
+
+    fflush(_winter.print.file);
+}
+
+/// Runs the body of the test. The first test block the suite function reaches jumps straight to the body through the
+/// entry, so a dispatch does not test the index of every test in the suite.
+WINTER_FUNC void
+_winter_test_call(const winter_unit_t* unit) {
+    _winter_local.unit = unit;
+    _winter_local.entry = unit->test->entry;
+    unit->suite->func(unit->test->id);
+    _winter_local.entry = nullptr;
+}
+
+/// Pins the calling thread to the CPU, on Darwin threads can only be grouped by affinity tags which are a hint.
+WINTER_FUNC void
+_winter_thread_pin(const uint16_t thread_id, const int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    const int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        _winter_print(WINTER_INDENT "Failed to pin thread %u to CPU %i (%s).\n", thread_id, cpu, strerror(ret));
+        _exit(WINTER_EXIT_FAILURE);
+    }
+#elif defined(__APPLE__)
+    thread_affinity_policy_data_t policy = { .affinity_tag = cpu + 1 };
+    thread_policy_set(
+      pthread_mach_thread_np(pthread_self()),
+      THREAD_AFFINITY_POLICY,
+      (thread_policy_t)&policy,
+      THREAD_AFFINITY_POLICY_COUNT
+    );
+    (void)thread_id;
+#else
+    (void)thread_id;
+#endif
+}
+
+/// CPUs the process may run on, in ascending order. Returns their number.
+WINTER_FUNC int
+_winter_allowed_cpus(int* cpus, const int capacity) {
+    int count = 0;
+
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE && count < capacity; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus[count++] = cpu;
+            }
+        }
+    }
+#endif
+
+    if (count == 0) {
+        const long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < online && count < capacity; ++cpu) {
+            cpus[count++] = cpu;
+        }
+    }
+
+    return count;
+}
+
+/// Parses a list like 0,2,4-7 into the CPUs. Returns their number.
+WINTER_FUNC int
+_winter_parse_cpus(const char* list, int* cpus, const int capacity) {
+    int count = 0;
+
+    for (const char* it = list; *it != '\0';) {
+        char* end;
+        const long first = strtol(it, &end, 10);
+        long last = first;
+
+        if (end != it && *end == '-') {
+            it = end + 1;
+            last = strtol(it, &end, 10);
+        }
+        if (end == it || first < 0 || last < first || last >= WINTER_MAX_CPUS || (*end != ',' && *end != '\0')) {
+            _winter_fatal_error("Invalid affinity: %s", list);
+        }
+
+        for (long cpu = first; cpu <= last && count < capacity; ++cpu) {
+            cpus[count++] = (int)cpu;
+        }
+
+        it = *end == ',' ? end + 1 : end;
+    }
+
+    if (count == 0) {
+        _winter_fatal_error("Invalid affinity: %s", list);
+    }
+
+    return count;
+}
+
+/// Chooses the CPU of every thread of a test: spread places them as far apart as possible in the allowed CPUs,
+/// compact next to each other and a list assigns its CPUs in order. Without a policy threads are not pinned.
+WINTER_FUNC void
+_winter_affinity_resolve(const char* policy, const uint16_t threads, int* out) {
+    for (uint16_t i = 0; i < threads; ++i) {
+        out[i] = -1;
+    }
+    if (policy == nullptr || strcmp(policy, "none") == 0) {
+        return;
+    }
+
+    int cpus[WINTER_MAX_CPUS];
+    const bool spread = strcmp(policy, "spread") == 0;
+    const bool compact = strcmp(policy, "compact") == 0;
+
+    const int count = spread || compact ? _winter_allowed_cpus(cpus, WINTER_MAX_CPUS)
+                                        : _winter_parse_cpus(policy, cpus, WINTER_MAX_CPUS);
+
+    for (uint16_t i = 0; i < threads; ++i) {
+        const bool stride = spread && threads <= count;
+        out[i] = cpus[stride ? (int)(i * (uint32_t)count / threads) : i % count];
+    }
+}
+
+WINTER_FUNC void
+_winter_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+/// Sleeps while the value at the address equals the expected value, may return early.
+WINTER_FUNC void
+_winter_futex_wait(_Atomic uint32_t* address, const uint32_t expected) {
+#if defined(__linux__)
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+    extern int __ulock_wait(uint32_t, void*, uint64_t, uint32_t);
+    __ulock_wait(1 /* UL_COMPARE_AND_WAIT */, (void*)address, expected, 0);
+#else
+    (void)address;
+    (void)expected;
+    sched_yield();
+#endif
+}
+
+WINTER_FUNC void
+_winter_futex_wake_all(_Atomic uint32_t* address) {
+#if defined(__linux__)
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+    extern int __ulock_wake(uint32_t, void*, uint64_t);
+    __ulock_wake(1 /* UL_COMPARE_AND_WAIT */ | 0x100 /* ULF_WAKE_ALL */, (void*)address, 0);
+#else
+    (void)address;
+#endif
+}
+
+/// Sense reversing barrier. The last thread to arrive resets the count and flips the sense, which releases all threads
+/// spinning on it at once. Threads that spun for too long sleep on the sense and are woken by the last thread.
+WINTER_FUNC void
+_winter_thread_spin_syncronize(void) {
+    const uint32_t sense = atomic_load_explicit(&_winter.synchronization.sense, memory_order_acquire);
+
+    const uint32_t arrived = atomic_fetch_add_explicit(&_winter.synchronization.arrived, 1, memory_order_acq_rel);
+    if (arrived + 1 == _winter.synchronization.threads) {
+        atomic_store_explicit(&_winter.synchronization.arrived, 0, memory_order_relaxed);
+        atomic_store(&_winter.synchronization.sense, sense + 1);
+
+        if (atomic_load(&_winter.synchronization.sleepers) != 0) {
+            _winter_futex_wake_all(&_winter.synchronization.sense);
+        }
+        return;
+    }
+
+    uint32_t backoff = 1;
+    for (uint32_t i = 0; i < _winter.synchronization.spins; ++i) {
+        if (atomic_load_explicit(&_winter.synchronization.sense, memory_order_acquire) != sense) {
+            return;
+        }
+
+        for (uint32_t j = 0; j < backoff; ++j) {
+            _winter_cpu_relax();
+        }
+        backoff = backoff < WINTER_BARRIER_BACKOFF ? backoff * 2 : backoff;
+    }
+
+    // the last thread reads sleepers after flipping the sense, so either it wakes us or we see the new sense
+    atomic_fetch_add(&_winter.synchronization.sleepers, 1);
+    while (atomic_load(&_winter.synchronization.sense) == sense) {
+        _winter_futex_wait(&_winter.synchronization.sense, sense);
+    }
+    atomic_fetch_sub(&_winter.synchronization.sleepers, 1);
+}
+
+WINTER_FUNC void
+_winter_thread_syncronize(void) {
+    if (_winter.synchronization.barrier == WINTER_BARRIER_SPIN) {
+        _winter_thread_spin_syncronize();
+        return;
+    }
+
+    pthread_mutex_lock(&_winter.synchronization.mutex);
+
+    const uint64_t generation = _winter.synchronization.generation;
+
+    if (++_winter.synchronization.waiting == _winter.synchronization.threads) {
+        _winter.synchronization.waiting = 0;
+        _winter.synchronization.generation += 1;
+        pthread_cond_broadcast(&_winter.synchronization.cond);
+    } else {
+        while (_winter.synchronization.generation == generation) {
+            pthread_cond_wait(&_winter.synchronization.cond, &_winter.synchronization.mutex);
+        }
+    }
+    pthread_mutex_unlock(&_winter.synchronization.mutex);
+}
+
+/// Barrier of synchronize(). With --jitter every thread spins for a random time of up to the jitter first, so the
+/// threads leave the barrier in orders they would rarely take otherwise.
+WINTER_FUNC void
+_winter_synchronize(void) {
+    if (_winter.opts.jitter_ns != 0) {
+        const uint64_t end = _winter_now() + _winter_splitmix(&_winter_local.jitter) % (_winter.opts.jitter_ns + 1);
+        while (_winter_now() < end) {
+            _winter_cpu_relax();
+        }
+    }
+
+    _winter_thread_syncronize();
+}
+
+/// Whether a repeated unit runs another iteration, called by the first thread while the others wait at the barrier.
+/// The seed of the first iteration is the --seed, every further seed is derived from the one before, so a failing
+/// iteration is reproduced by starting with its seed. The fixtures of the suite run around every iteration.
+WINTER_FUNC bool
+_winter_repeat_next(const winter_unit_t* unit) {
+    winter_repeat_t* repeat = unit->repeat;
+    const uint64_t iteration = atomic_load(&repeat->iteration);
+    const uint64_t now = _winter_now();
+
+    uint64_t seed;
+    if (iteration == 0) {
+        seed = _winter.opts.seeded ? _winter.opts.seed : now ^ ((uint64_t)getpid() << 32);
+        _winter.repeat.end_time = _winter.opts.stress_ns != 0 ? now + _winter.opts.stress_ns : 0;
+    } else {
+        const uint64_t limit = _winter.opts.repeat != 0 ? _winter.opts.repeat : _winter.opts.stress_ns != 0 ? 0 : 1;
+        if ((limit != 0 && iteration >= limit) || (_winter.repeat.end_time != 0 && now >= _winter.repeat.end_time)) {
+            return false;
+        }
+
+        unit->suite->func(WINTER_FUNC_AFTER_EACH);
+        unit->suite->func(WINTER_FUNC_BEFORE_EACH);
+
+        seed = atomic_load(&repeat->seed);
+        seed = _winter_splitmix(&seed);
+    }
+
+    // properties in the body draw their cases from the seed of the iteration as well
+    _winter.opts.seeded = true;
+    _winter.opts.seed = seed;
+
+    atomic_store(&repeat->seed, seed);
+    atomic_store(&repeat->start_time, _winter_now());
+    atomic_store(&repeat->iteration, iteration + 1);
+    return true;
+}
+
+/// Runs the body for every iteration of a repeated unit on the thread. The threads stay alive between the iterations,
+/// the barrier is passed once before the body, when the next iteration has been decided, and once after it.
+WINTER_FUNC void
+_winter_repeat_run(const winter_unit_t* unit) {
+    while (true) {
+        if (_winter_local.thread_id == 0) {
+            _winter.repeat.running = _winter_repeat_next(unit);
+        }
+        _winter_thread_syncronize();
+
+        if (!_winter.repeat.running) {
+            return;
+        }
+
+        _winter_local.jitter = atomic_load(&unit->repeat->seed) ^ ((_winter_local.thread_id + 1ULL) << 48);
+        _winter_test_call(unit);
+        _winter_thread_syncronize();
+    }
+}
+
+WINTER_FUNC void*
+_winter_thread_entry(void* void_args) {
+    const winter_args_t* args = void_args;
+    _winter_local.thread_id = args->thread_id;
+    _winter_thread_pin(args->thread_id, args->cpu);
+
+    // start gate, so no thread runs the body before the last one has been created
+    _winter_thread_syncronize();
+
+    if (args->unit->repeat != nullptr) {
+        _winter_repeat_run(args->unit);
+    } else {
+        _winter_test_call(args->unit);
+    }
+    return nullptr;
+}
+
+WINTER_FUNC void
+_winter_process_entry(winter_unit_t* unit) {
+    unit->suite->func(WINTER_FUNC_BEFORE_EACH);
+
+    pthread_mutex_init(&_winter.synchronization.mutex, nullptr);
+    pthread_cond_init(&_winter.synchronization.cond, nullptr);
+    _winter.synchronization.waiting = 0;
+    _winter.synchronization.threads = unit->test->threads;
+    _winter.synchronization.generation = 0;
+    _winter.synchronization.barrier = unit->test->barrier != WINTER_BARRIER_DEFAULT ? unit->test->barrier
+                                                                                    : _winter.opts.barrier;
+    atomic_store(&_winter.synchronization.arrived, 0);
+    atomic_store(&_winter.synchronization.sense, 0);
+    atomic_store(&_winter.synchronization.sleepers, 0);
+
+    // spinning only helps while every thread has a CPU, otherwise it delays the threads that still have to arrive
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    _winter.synchronization.spins = cpus >= unit->test->threads ? WINTER_BARRIER_SPINS : 0;
+
+    int affinity[unit->test->threads];
+    _winter_affinity_resolve(
+      unit->test->affinity != nullptr ? unit->test->affinity : _winter.opts.affinity, unit->test->threads, affinity
+    );
+
+    _winter_alloc_begin(unit->allocs);
+    _winter_counters_begin(unit->counters);
+
+    if (unit->test->threads == 1) {
+        _winter_local.thread_id = 0;
+        _winter_thread_pin(0, affinity[0]);
+        if (unit->repeat != nullptr) {
+            _winter_repeat_run(unit);
+        } else {
+            _winter_test_call(unit);
+        }
+    } else {
+        pthread_t threads[unit->test->threads];
+        winter_args_t args[unit->test->threads];
+
+        for (uint16_t i = 0; i < unit->test->threads; ++i) {
+            args[i] = (winter_args_t){
+                .unit = unit,
+                .thread_id = i,
+                .cpu = affinity[i],
+            };
+
+            if (pthread_create(&threads[i], nullptr, _winter_thread_entry, &args[i]) != 0) {
+                _winter_print(WINTER_INDENT "Failed to create thread (%s).\n", strerror(errno));
+                _exit(WINTER_EXIT_FAILURE);
+            }
+        }
+        for (uint16_t i = 0; i < unit->test->threads; ++i) {
+            if (pthread_join(threads[i], nullptr)) {
+                _winter_print(WINTER_INDENT "Failed to join thread (%s).\n", strerror(errno));
+                _exit(WINTER_EXIT_FAILURE);
+            }
+        }
+    }
+
+    _winter_counters_end(unit->counters);
+    _winter_alloc_end();
+
+    unit->suite->func(WINTER_FUNC_AFTER_EACH);
+}
+
+static volatile sig_atomic_t _winter_debug_abort = false;
+
+WINTER_FUNC void
+_winter_debug_handler(const int sig) {
+    (void)sig;
+    _winter_debug_abort = true;
+}
+
+/// Kills and reaps the process, storing its resource usage if usage is not null.
+WINTER_FUNC void
+_winter_kill_process(const pid_t pid, struct rusage* usage) {
+    if (kill(pid, SIGCONT) == -1) {
+        _winter_print(WINTER_INDENT "Failed to continue process (%s).\n", strerror(errno));
+        return;
+    }
+
+    if (kill(pid, SIGKILL) == -1) {
+        _winter_print(WINTER_INDENT "Failed to kill process (%s).\n", strerror(errno));
+        return;
+    }
+
+    if (wait4(pid, nullptr, 0, usage) == -1) {
+        _winter_print(WINTER_INDENT "Waiting for terminated process failed (%s).\n", strerror(errno));
+    }
+}
+
+// ### PROPERTIES #####################################################################################################
+
+/// Shortlex order of choices, shorter sequences are smaller.
+WINTER_FUNC bool
+_winter_shrink_better(const uint64_t* a, const uint32_t a_length, const uint64_t* b, const uint32_t b_length) {
+    if (a_length != b_length) {
+        return a_length < b_length;
+    }
+
+    for (uint32_t i = 0; i < a_length; ++i) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i];
+        }
+    }
+
+    return false;
+}
+
+WINTER_FUNC void
+_winter_shrink_init(winter_shrink_t* shrink, const uint64_t* choices, const uint32_t length) {
+    memset(shrink, 0, offsetof(winter_shrink_t, choices));
+    shrink->pass = _WINTER_SHRINK_DELETE;
+    shrink->block = WINTER_PROPERTY_BLOCK;
+    shrink->length = length;
+    memmove(shrink->choices, choices, length * sizeof(uint64_t));
+}
+
+/// Writes the next candidate into the choices. Returns false once a round over all choices found nothing smaller or
+/// WINTER_PROPERTY_SHRINKS candidates have been tried.
+WINTER_FUNC bool
+_winter_shrink_next(winter_shrink_t* shrink, uint64_t* choices, uint32_t* length) {
+    while (shrink->attempts < WINTER_PROPERTY_SHRINKS) {
+        if (shrink->pass == _WINTER_SHRINK_DELETE) {
+            if (shrink->position + shrink->block > shrink->length) {
+                shrink->position = 0;
+                if (shrink->block > 1) {
+                    shrink->block /= 2;
+                } else {
+                    shrink->pass = _WINTER_SHRINK_LOWER;
+                }
+                continue;
+            }
+
+            const uint32_t tail = shrink->position + shrink->block;
+            memcpy(choices, shrink->choices, shrink->position * sizeof(uint64_t));
+            memcpy(choices + shrink->position, shrink->choices + tail, (shrink->length - tail) * sizeof(uint64_t));
+            *length = shrink->length - shrink->block;
+
+            shrink->attempts += 1;
+            return true;
+        }
+
+        if (shrink->position >= shrink->length) {
+            if (!shrink->improved) {
+                return false;
+            }
+
+            shrink->improved = false;
+            shrink->pass = _WINTER_SHRINK_DELETE;
+            shrink->block = WINTER_PROPERTY_BLOCK;
+            shrink->position = 0;
+            continue;
+        }
+
+        if (!shrink->searching) {
+            shrink->searching = true;
+            shrink->low = 0;
+            shrink->high = shrink->choices[shrink->position];
+            shrink->step = 0;
+        }
+        if (shrink->low >= shrink->high) {
+            if (shrink->step >= WINTER_PROPERTY_STEPS || shrink->step >= shrink->high) {
+                shrink->searching = false;
+                shrink->position += 1;
+                continue;
+            }
+
+            shrink->step += 1;
+            shrink->tried = shrink->high - shrink->step;
+        } else {
+            shrink->tried = shrink->low + (shrink->high - shrink->low) / 2;
+        }
+
+        memcpy(choices, shrink->choices, shrink->length * sizeof(uint64_t));
+        choices[shrink->position] = shrink->tried;
+        *length = shrink->length;
+
+        shrink->attempts += 1;
+        return true;
+    }
+
+    return false;
+}
+
+/// Reports whether the last candidate failed, with the choices the case actually drew.
+WINTER_FUNC void
+_winter_shrink_result(winter_shrink_t* shrink, const bool failed, const uint64_t* choices, const uint32_t length) {
+    const bool better = failed && _winter_shrink_better(choices, length, shrink->choices, shrink->length);
+    if (better) {
+        memcpy(shrink->choices, choices, length * sizeof(uint64_t));
+        shrink->length = length;
+        shrink->improved = true;
+        shrink->steps += 1;
+    }
+
+    if (shrink->pass == _WINTER_SHRINK_DELETE) {
+        // a deletion that failed moves the following choices to the same position
+        shrink->position += better ? 0 : 1;
+    } else if (better && shrink->position < shrink->length) {
+        shrink->high = shrink->choices[shrink->position];
+        if (shrink->step > 0) {
+            // a step that failed starts a new search below it
+            shrink->low = 0;
+            shrink->step = 0;
+        }
+    } else if (shrink->step == 0) {
+        shrink->low = shrink->tried + 1;
+    }
+}
+
+/// Draws a choice between 0 and the bound. Replayed choices larger than the bound are reduced into it, once the
+/// replayed choices run out every choice is zero.
+WINTER_FUNC uint64_t
+_winter_property_draw(winter_property_t* property, const uint64_t bound) {
+    uint64_t value = 0;
+    if (property->index < property->length) {
+        value = property->choices[property->index];
+    } else if (!property->replaying) {
+        value = _winter_splitmix(&property->state);
+    }
+
+    if (bound != UINT64_MAX && value > bound) {
+        value %= bound + 1;
+    }
+
+    if (property->index < WINTER_PROPERTY_CHOICES) {
+        property->choices[property->index++] = value;
+    } else {
+        property->overflow = true;
+    }
+
+    return value;
+}
+
+WINTER_FUNC winter_property_t*
+_winter_property_current(void) {
+    if (_winter_local.property == nullptr) {
+        _winter_fatal_error("Generators can only be used in the body of a property");
+    }
+
+    return _winter_local.property;
+}
+
+/// Maps choices to values by distance from zero, alternating between the positive and the negative side while both
+/// are in the range.
+WINTER_FUNC intmax_t
+_winter_gen_int(const intmax_t min, const intmax_t max) {
+    winter_property_t* property = _winter_property_current();
+    if (min > max) {
+        _winter_fatal_error("Invalid generator range: %jd > %jd", min, max);
+    }
+
+    const uint64_t choice = _winter_property_draw(property, (uint64_t)max - (uint64_t)min);
+
+    intmax_t value;
+    if (min >= 0) {
+        value = (intmax_t)((uint64_t)min + choice);
+    } else if (max <= 0) {
+        value = (intmax_t)((uint64_t)max - choice);
+    } else {
+        const uint64_t negative = -(uint64_t)min;
+        const uint64_t both = (uint64_t)max < negative ? (uint64_t)max : negative;
+
+        uint64_t distance;
+        bool positive;
+        if (choice <= 2 * both) {
+            distance = (choice + 1) / 2;
+            positive = choice % 2 == 0;
+        } else {
+            distance = both + (choice - 2 * both);
+            positive = (uint64_t)max > negative;
+        }
+        value = positive ? (intmax_t)distance : (intmax_t)(0 - distance);
+    }
+
+    if (property->verbose) {
+        _winter_print(WINTER_INDENT "Generated int: %jd\n", value);
+    }
+
+    return value;
+}
+
+WINTER_FUNC uint64_t
+_winter_gen_uint(const uint64_t max) {
+    winter_property_t* property = _winter_property_current();
+    const uint64_t value = _winter_property_draw(property, max);
+
+    if (property->verbose) {
+        _winter_print(WINTER_INDENT "Generated uint: %ju\n", (uintmax_t)value);
+    }
+
+    return value;
+}
+
+WINTER_FUNC size_t
+_winter_gen_bytes(void* buffer, const size_t max_length) {
+    winter_property_t* property = _winter_property_current();
+    uint8_t* bytes = buffer;
+
+    const size_t length = _winter_property_draw(property, max_length);
+    for (size_t i = 0; i < length; ++i) {
+        bytes[i] = (uint8_t)_winter_property_draw(property, UINT8_MAX);
+    }
+
+    if (property->verbose) {
+        _winter_print(WINTER_INDENT "Generated bytes (%zu):", length);
+        for (size_t i = 0; i < length && i < 64; ++i) {
+            _winter_print(" %02x", bytes[i]);
+        }
+        _winter_print("%s\n", length > 64 ? " ..." : "");
+    }
+
+    return length;
+}
+
+/// Printable ASCII string, the buffer needs room for the terminating zero after max_length characters.
+WINTER_FUNC size_t
+_winter_gen_str(char* buffer, const size_t max_length) {
+    winter_property_t* property = _winter_property_current();
+
+    const size_t length = _winter_property_draw(property, max_length);
+    for (size_t i = 0; i < length; ++i) {
+        buffer[i] = (char)(' ' + _winter_property_draw(property, '~' - ' '));
+    }
+    buffer[length] = '\0';
+
+    if (property->verbose) {
+        _winter_print(WINTER_INDENT "Generated string (%zu): \"%s\"\n", length, buffer);
+    }
+
+    return length;
+}
+
+/// Fails the running case, called by every failed assertion. Jumps back to the property block, which decides what the
+/// next case is.
+WINTER_FUNC void
+_winter_property_fail(void) {
+    winter_property_t* property = _winter_local.property;
+    if (property == nullptr || !property->running) {
+        return;
+    }
+
+    property->failed = true;
+    pthread_mutex_unlock(&_winter.print.mutex);
+    siglongjmp(property->jump, 1);
+}
+
+WINTER_FUNC winter_property_t*
+_winter_property_begin(const uint64_t iterations) {
+    winter_unit_t* unit = (winter_unit_t*)_winter_local.unit;
+    if (unit->property == nullptr) {
+        unit->property = _winter_shared_map(sizeof(winter_property_t));
+    }
+
+    winter_property_t* property = unit->property;
+    property->output = _winter.print.file;
+    property->quiet = fopen("/dev/null", "w");
+    property->running = false;
+    _winter_local.property = property;
+
+    if (property->phase != _WINTER_PROPERTY_REPLAY) {
+        property->phase = _WINTER_PROPERTY_GENERATE;
+        property->verbose = false;
+        property->iterations = iterations;
+        property->cases = 0;
+        property->reported = false;
+        property->next_seed = _winter.opts.seeded ? _winter.opts.seed : _winter_now() ^ ((uint64_t)getpid() << 32);
+    }
+
+    if (!property->verbose && property->quiet != nullptr) {
+        _winter.print.file = property->quiet;
+    }
+
+    return property;
+}
+
+WINTER_FUNC bool
+_winter_property_start(winter_property_t* property, const bool replaying) {
+    error_clear();
+
+    property->replaying = replaying;
+    property->overflow = false;
+    property->failed = false;
+    property->index = 0;
+    property->running = true;
+    return true;
+}
+
+/// Starts a new case, its seed is derived from the seed of the case before, so --seed reproduces the first one.
+WINTER_FUNC bool
+_winter_property_generate(winter_property_t* property) {
+    property->seed = property->next_seed;
+    property->next_seed = _winter_splitmix(&property->next_seed);
+    property->state = property->seed;
+    property->length = 0;
+    property->cases += 1;
+    return _winter_property_start(property, false);
+}
+
+/// Drives the loop of a property block, called before every case. Generates iterations cases, the first failing one is
+/// shrunk in the test process and replayed once more with the generated values printed.
+WINTER_FUNC bool
+_winter_property_next(winter_property_t* property) {
+    if (!property->running) {
+        if (property->phase == _WINTER_PROPERTY_REPLAY) {
+            return _winter_property_start(property, true);
+        }
+        return _winter_property_generate(property);
+    }
+
+    property->running = false;
+
+    switch (property->phase) {
+    case _WINTER_PROPERTY_GENERATE:
+        if (!property->failed) {
+            if (property->cases < property->iterations) {
+                return _winter_property_generate(property);
+            }
+
+            _winter.print.file = property->output;
+            _winter_local.property = nullptr;
+            if (property->quiet != nullptr) {
+                fclose(property->quiet);
+            }
+            return false;
+        }
+
+        // choices that did not fit can not be replayed, only the seed reproduces the case
+        if (property->overflow) {
+            property->phase = _WINTER_PROPERTY_FINAL;
+            property->verbose = true;
+            property->state = property->seed;
+            property->length = 0;
+            _winter.print.file = property->output;
+            return _winter_property_start(property, false);
+        }
+
+        property->phase = _WINTER_PROPERTY_SHRINK;
+        _winter_shrink_init(&property->shrink, property->choices, property->index);
+        break;
+    case _WINTER_PROPERTY_SHRINK:
+        _winter_shrink_result(
+          &property->shrink, property->failed && !property->overflow, property->choices, property->index
+        );
+        break;
+    case _WINTER_PROPERTY_FINAL:
+        pthread_mutex_lock(&_winter.print.mutex);
+        if (!property->failed) {
+            _winter_print(WINTER_INDENT "The shrunk case passed when it was replayed, the property is flaky.\n");
+        }
+        _winter_print(
+          WINTER_INDENT "Falsified after %ju cases, shrunk %u times. Reproduce with --seed 0x%016jx\n",
+          (uintmax_t)property->cases,
+          property->shrink.steps,
+          (uintmax_t)property->seed
+        );
+        fflush(_winter.print.file);
+
+        property->reported = true;
+        _exit(WINTER_EXIT_FAILURE);
+    case _WINTER_PROPERTY_REPLAY:
+        fflush(_winter.print.file);
+        _exit(property->failed ? WINTER_EXIT_FAILURE : 0);
+    }
+
+    if (_winter_shrink_next(&property->shrink, property->choices, &property->length)) {
+        return _winter_property_start(property, true);
+    }
+
+    property->phase = _WINTER_PROPERTY_FINAL;
+    property->verbose = true;
+    property->length = property->shrink.length;
+    memcpy(property->choices, property->shrink.choices, property->length * sizeof(uint64_t));
+    _winter.print.file = property->output;
+    return _winter_property_start(property, true);
+}
+
+/// Forks a test process that runs the choices of the property once. Returns its pid or -1. The output of a verbose
+/// replay goes into the output of the unit through a pipe the runner drains, the output of the others is discarded.
+WINTER_FUNC pid_t
+_winter_property_replay(const winter_unit_t* unit, const bool verbose) {
+    unit->property->phase = _WINTER_PROPERTY_REPLAY;
+    unit->property->verbose = verbose;
+
+    int fds[2] = { -1, -1 };
+    if (verbose ? pipe(fds) == -1 : (fds[1] = open("/dev/null", O_WRONLY)) == -1) {
+        _winter_unit_print(unit, WINTER_INDENT "Failed to open the output of a replay (%s).\n", strerror(errno));
+        return -1;
+    }
+
+    // the replay does not count into the allocations and counters of the unit
+    winter_unit_t replay = *unit;
+    replay.allocs = nullptr;
+    replay.bench = nullptr;
+    replay.counters = nullptr;
+    replay.repeat = nullptr;
+
+    fflush(nullptr);
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[1]);
+        if (fds[0] != -1) {
+            close(fds[0]);
+        }
+        setvbuf(stdout, nullptr, _IONBF, 0);
+        setvbuf(stderr, nullptr, _IONBF, 0);
+        _winter.print.file = stderr;
+
+        // a shrunk case may never end, it gets as long as the whole test
+        alarm((unsigned)ceil(unit->timeout / 1000));
+
+        _winter_process_entry(&replay);
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    if (fds[0] != -1) {
+        if (pid == -1) {
+            close(fds[0]);
+        } else {
+            // the pipe of the crashed process has been drained to its end
+            _winter_output_drain(unit->output);
+            if (unit->output->fd >= 0) {
+                close(unit->output->fd);
+            }
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            unit->output->fd = fds[0];
+        }
+    }
+
+    if (pid == -1) {
+        _winter_unit_print(unit, WINTER_INDENT "Failed to fork replay process (%s).\n", strerror(errno));
+    }
+
+    return pid;
+}
+
+/// Whether the unit is a property whose case crashed the test process, the case is then shrunk by replaying it.
+WINTER_FUNC bool
+_winter_property_crashed(const winter_unit_t* unit) {
+    const winter_property_t* property = unit->property;
+    return property != nullptr && property->running && !property->reported && unit->signal != 0 && !unit->timed_out;
+}
+
+/// Tells how the crashed case was found and shrunk.
+WINTER_FUNC void
+_winter_property_crash_report(const winter_unit_t* unit) {
+    const winter_property_t* property = unit->property;
+    _winter_unit_print(
+      unit,
+      WINTER_INDENT "Crashed after %ju cases, shrunk %u times. Reproduce with --seed 0x%016jx\n",
+      (uintmax_t)property->cases,
+      property->shrink.steps,
+      (uintmax_t)property->seed
+    );
+}
+
+// ### PROCESS WAITING ################################################################################################
+
+/// Registers the process of a job, such that _winter_wait wakes up as soon as it exits. Falls back to polling every
+/// WINTER_PROCESS_POLL_MS if the platform provides no way to wait for a process.
+WINTER_FUNC void
+_winter_wait_watch(winter_job_t* job) {
+    job->fd = -1;
+
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    job->fd = (int)syscall(SYS_pidfd_open, job->pid, 0);
+#elif defined(__APPLE__)
+    if (_winter.wait.queue == -1) {
+        _winter.wait.queue = kqueue();
+    }
+    if (_winter.wait.queue == -1) {
+        return;
+    }
+
+    struct kevent change;
+    EV_SET(&change, job->pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+    if (kevent(_winter.wait.queue, &change, 1, nullptr, 0, nullptr) == 0) {
+        job->fd = 0;
+    }
+
+    // the output wakes the runner as well, closing the pipe removes the event
+    if (job->unit.output != nullptr && job->unit.output->fd >= 0) {
+        EV_SET(&change, job->unit.output->fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+        kevent(_winter.wait.queue, &change, 1, nullptr, 0, nullptr);
+    }
+#endif
+}
+
+WINTER_FUNC void
+_winter_wait_release(winter_job_t* job) {
+#if defined(__linux__)
+    if (job->fd >= 0) {
+        close(job->fd);
+    }
+#endif
+
+    job->fd = -1;
+}
+
+/// Blocks until one of the running jobs might have exited, a signal was received or the timeout has passed. A negative
+/// timeout waits without a deadline. Callers still have to check every job, the wakeup carries no information.
+WINTER_FUNC void
+_winter_wait(const winter_job_t* jobs, const uint32_t count, double timeout_ms) {
+    bool polling = false;
+    for (uint32_t i = 0; i < count; ++i) {
+        // batches report their units while the process keeps running
+        polling |= (jobs[i].pid > 0 && jobs[i].fd < 0) || jobs[i].batch != nullptr;
+    }
+    if (polling && (timeout_ms < 0 || timeout_ms > WINTER_PROCESS_POLL_MS)) {
+        timeout_ms = WINTER_PROCESS_POLL_MS;
+    }
+
+#if defined(__linux__)
+    struct pollfd fds[count * 2];
+    nfds_t length = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (jobs[i].pid > 0 && jobs[i].fd >= 0) {
+            fds[length++] = (struct pollfd){ .fd = jobs[i].fd, .events = POLLIN };
+        }
+
+        // a process writing more than the pipe holds blocks until its output is read
+        if (jobs[i].pid > 0 && jobs[i].unit.output != nullptr && jobs[i].unit.output->fd >= 0) {
+            fds[length++] = (struct pollfd){ .fd = jobs[i].unit.output->fd, .events = POLLIN };
+        }
+    }
+
+    // round up, otherwise the deadline is missed and the loop spins for the last millisecond
+    poll(fds, length, timeout_ms < 0 ? -1 : (int)timeout_ms + 1);
+#elif defined(__APPLE__)
+    if (_winter.wait.queue == -1) {
+        _winter_sleep_ms(timeout_ms < 0 ? WINTER_PROCESS_POLL_MS : (uint32_t)timeout_ms + 1);
+        return;
+    }
+
+    const struct timespec ts = {
+        .tv_sec = (time_t)(timeout_ms / 1000),
+        .tv_nsec = (long)((timeout_ms - (double)(time_t)(timeout_ms / 1000) * 1000) * 1000000),
+    };
+
+    struct kevent event;
+    kevent(_winter.wait.queue, nullptr, 0, &event, 1, timeout_ms < 0 ? nullptr : &ts);
+#else
+    _winter_sleep_ms(timeout_ms < 0 ? WINTER_PROCESS_POLL_MS : (uint32_t)timeout_ms + 1);
+#endif
+}
+
+/// Milliseconds since the unit started, for a repeated unit since its running iteration started. The timeout of the
+/// test applies to every iteration.
+WINTER_FUNC double
+_winter_unit_elapsed_ms(const winter_unit_t* unit) {
+    uint64_t start_time = unit->start_time;
+    if (unit->repeat != nullptr) {
+        const uint64_t iteration_start = atomic_load(&unit->repeat->start_time);
+        start_time = iteration_start > start_time ? iteration_start : start_time;
+    }
+
+    return _winter_elapsed_ms(start_time);
+}
+
+/// Time in milliseconds until the first running job reaches its timeout, or -1 if no job can time out.
+WINTER_FUNC double
+_winter_wait_timeout(const winter_job_t* jobs, const uint32_t count) {
+    if (!_winter.opts.timeout) {
+        return -1;
+    }
+
+    double timeout_ms = -1;
+    for (uint32_t i = 0; i < count; ++i) {
+        // a replay ends itself through an alarm, the deadline of its unit has passed already
+        if (jobs[i].pid <= 0 || jobs[i].crashed != nullptr) {
+            continue;
+        }
+
+        double remaining = jobs[i].unit.timeout - _winter_unit_elapsed_ms(&jobs[i].unit);
+        if (remaining < 0) {
+            remaining = 0;
+        }
+        if (timeout_ms < 0 || remaining < timeout_ms) {
+            timeout_ms = remaining;
+        }
+    }
+
+    return timeout_ms;
+}
+
+/// Runs the unit in a process that waits for a debugger to attach. Returns true once waiting was aborted.
+WINTER_FUNC bool
+_winter_unit_debug(winter_unit_t* unit) {
+    // the debugger interaction and the output of the test would corrupt a machine readable report on stdout
+    FILE* const report = _winter.print.file;
+    if (_winter.opts.reporter != WINTER_REPORTER_TEXT) {
+        _winter.print.file = stderr;
+    }
+    _winter_print_unit_debug(unit);
+
+    // anything still buffered would otherwise be written a second time by the child
+    fflush(nullptr);
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        if (_winter.opts.reporter != WINTER_REPORTER_TEXT) {
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+        setvbuf(stderr, nullptr, _IONBF, 0);
+        raise(SIGSTOP);
+        _winter_process_entry(unit);
+        _exit(0);
+    }
+
+    // no SA_RESTART, ctrl-c has to interrupt waiting for the process
+    const struct sigaction action = { .sa_handler = _winter_debug_handler };
+    sigaction(SIGINT, &action, nullptr);
+    _winter_debug_abort = false;
+
+    _winter_print(WINTER_INDENT "Waiting for debugger to attach, press ctrl-c to abort... (pid %d)\n", pid);
+    fflush(_winter.print.file);
+
+    winter_job_t job = { .unit = *unit, .pid = pid };
+    _winter_wait_watch(&job);
+
+    while (true) {
+        const pid_t ret = waitpid(pid, nullptr, WNOHANG);
+
+        if (ret == pid) {
+            _winter_print(WINTER_INDENT "Test process exited. Restarting test.\n");
+            break;
+        }
+
+        if (_winter_debug_abort) {
+            _winter_kill_process(pid, nullptr);
+            _winter_print("\r" WINTER_INDENT "Waiting aborted by user.\n");
+            break;
+        }
+
+        if (ret == -1 && errno != EINTR && errno != ECHILD) {
+            _winter_print(WINTER_INDENT "Waiting for debug process failed (%s).\n", strerror(errno));
+            break;
+        }
+
+        _winter_wait(&job, 1, -1);
+    }
+
+    _winter_wait_release(&job);
+    signal(SIGINT, SIG_DFL);
+    _winter.print.file = report;
+
+    return _winter_debug_abort;
+}
+
+/// Whether the body of the unit runs more than once in its process, benchmarks have iterations of their own.
+WINTER_FUNC bool
+_winter_is_repeated(const winter_unit_t* unit) {
+    const bool repeating = _winter.opts.repeat > 1 || _winter.opts.stress_ns != 0 || _winter.opts.jitter_ns != 0;
+    return repeating && !unit->test->bench;
+}
+
+/// Maps the memory the test process reports to the runner through.
+WINTER_FUNC void
+_winter_unit_map(winter_unit_t* unit) {
+    unit->allocs = _winter_alloc_map();
+    if (unit->test->bench && (_winter.opts.bench_save != nullptr || _winter.opts.bench_compare != nullptr)) {
+        unit->bench = _winter_shared_map(sizeof(winter_bench_stats_t));
+    }
+    if (_winter.opts.counters) {
+        unit->counters = _winter_shared_map(sizeof(winter_counters_t));
+    }
+    if (unit->test->property) {
+        unit->property = _winter_shared_map(sizeof(winter_property_t));
+    }
+    if (_winter_is_repeated(unit)) {
+        unit->repeat = _winter_shared_map(sizeof(winter_repeat_t));
+    }
+    unit->ring = _winter_shared_map(sizeof(winter_ring_t));
+}
+
+WINTER_FUNC void
+_winter_unit_unmap(winter_unit_t* unit) {
+    _winter_shared_unmap(unit->allocs, sizeof(winter_allocs_t));
+    unit->allocs = nullptr;
+    _winter_shared_unmap(unit->bench, sizeof(winter_bench_stats_t));
+    unit->bench = nullptr;
+    _winter_shared_unmap(unit->counters, sizeof(winter_counters_t));
+    unit->counters = nullptr;
+    _winter_shared_unmap(unit->property, sizeof(winter_property_t));
+    unit->property = nullptr;
+    _winter_shared_unmap(unit->repeat, sizeof(winter_repeat_t));
+    unit->repeat = nullptr;
+    _winter_shared_unmap(unit->ring, sizeof(winter_ring_t));
+    unit->ring = nullptr;
+}
+
+WINTER_FUNC pid_t
+_winter_unit_spawn(winter_unit_t* unit) {
+    int output_fd;
+    unit->output = _winter_output_open(&output_fd);
+    _winter_unit_map(unit);
+
+    // anything still buffered would otherwise be written a second time by the child
+    fflush(nullptr);
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(output_fd, STDOUT_FILENO);
+        dup2(output_fd, STDERR_FILENO);
+        close(output_fd);
+        setvbuf(stdout, nullptr, _IONBF, 0);
+        setvbuf(stderr, nullptr, _IONBF, 0);
+        _winter.print.file = stderr;
+
+        _winter_process_entry(unit);
+        _exit(0);
+    }
+
+    close(output_fd);
+
+    if (pid == -1) {
+        _winter_unit_print(unit, WINTER_INDENT "Failed to fork process (%s).\n", strerror(errno));
+    }
+
+    return pid;
+}
+
+WINTER_FUNC bool
+_winter_unit_status(winter_unit_t* unit, const int status) {
+    if (WIFEXITED(status)) {
+        const int code = WEXITSTATUS(status);
+        unit->exit_code = code;
+
+        if (code != 0) {
+            if (code != WINTER_EXIT_FAILURE) {
+                _winter_unit_print(unit, WINTER_INDENT "Process exited with code %d.\n", code);
+            }
+
+            return false;
+        }
+    } else if (WIFSIGNALED(status)) {
+        const int sig = WTERMSIG(status);
+        unit->signal = sig;
+
+        _winter_unit_print(unit, WINTER_INDENT "Process terminated by signal %d (%s).\n", sig, strsignal(sig));
+        return false;
+    } else {
+        _winter_unit_print(unit, WINTER_INDENT "Process ended abnormally (status=0x%x).\n", status);
+        return false;
+    }
+
+    return true;
+}
+
+WINTER_FUNC bool
+_winter_budget_check(
+  const winter_unit_t* unit,
+  const char* name,
+  const uint64_t value,
+  const uint64_t limit,
+  const char* suffix
+) {
+    if (limit == 0 || value <= limit) {
+        return true;
+    }
+
+    _winter_unit_print(
+      unit,
+      WINTER_INDENT "Exceeded %s budget: %ju%s > %ju%s.\n",
+      name,
+      (uintmax_t)value,
+      suffix,
+      (uintmax_t)limit,
+      suffix
+    );
+    return false;
+}
+
+/// Compares the resource usage of a finished unit with the budget of its test.
+WINTER_FUNC bool
+_winter_unit_budget(const winter_unit_t* unit) {
+    const winter_budget_t* budget = &unit->test->budget;
+    const struct rusage* usage = &unit->usage;
+    bool within = true;
+
+    within &= _winter_budget_check(unit, "rss", _winter_rss_bytes(usage) >> 20, budget->max_rss_mb, "MB");
+    within &= _winter_budget_check(unit, "minor fault", (uint64_t)usage->ru_minflt, budget->max_minor_faults, "");
+    within &= _winter_budget_check(unit, "major fault", (uint64_t)usage->ru_majflt, budget->max_major_faults, "");
+    within &= _winter_budget_check(
+      unit, "context switch", (uint64_t)(usage->ru_nvcsw + usage->ru_nivcsw), budget->max_switches, ""
+    );
+    if (unit->allocs != nullptr && unit->allocs->available) {
+        within &= _winter_budget_check(unit, "allocation", unit->allocs->allocs, budget->max_allocs, "");
+    }
+
+    return within;
+}
+
+/// Tells why the unit was killed, an adaptive timeout too short for a slow machine shows up as such.
+WINTER_FUNC void
+_winter_unit_print_timeout(const winter_unit_t* unit) {
+    const char* kind = unit->timeout != unit->test->timeout ? "adaptive timeout" : "timeout";
+    if (unit->timeout < 1000) {
+        _winter_unit_print(unit, WINTER_INDENT "Process timed out after %.0fms (%s).\n", unit->timeout, kind);
+    } else {
+        _winter_unit_print(unit, WINTER_INDENT "Process timed out after %.0fs (%s).\n", unit->timeout / 1000, kind);
+    }
+}
+
+/// Checks whether the process of a running job has finished without blocking. Returns true if the job is done and
+/// stores the result of the unit in success.
+WINTER_FUNC bool
+_winter_job_poll(winter_job_t* job, bool* success) {
+    _winter_output_drain(job->unit.output);
+
+    int status = 0;
+    const pid_t ret = wait4(job->pid, &status, WNOHANG, &job->unit.usage);
+
+    // child process exited
+    if (ret == job->pid) {
+        job->unit.end_time = _winter_now();
+        _winter_output_drain(job->unit.output);
+        *success = _winter_unit_status(&job->unit, status) && _winter_unit_budget(&job->unit);
+        return true;
+    }
+
+    // no status reported by child process
+    if (ret == 0) {
+        if (_winter.opts.timeout && _winter_unit_elapsed_ms(&job->unit) > job->unit.timeout) {
+            _winter_kill_process(job->pid, &job->unit.usage);
+            _winter_output_drain(job->unit.output);
+            job->unit.end_time = _winter_now();
+            job->unit.timed_out = true;
+            job->unit.signal = SIGKILL;
+            _winter_unit_print_timeout(&job->unit);
+            *success = false;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (ret == -1 && errno == EINTR) {
+        return false;
+    }
+
+    _winter_unit_print(&job->unit, WINTER_INDENT "Waiting for process failed (%s).\n", strerror(errno));
+    job->unit.end_time = _winter_now();
+    *success = false;
+    return true;
+}
+
+#define WINTER_HASH_SEED 0xcbf29ce484222325ULL
+
+/// FNV-1a, continues hashing the string from the given hash value.
+WINTER_FUNC uint64_t
+_winter_hash(uint64_t hash, const char* str) {
+    for (; *str != '\0'; ++str) {
+        hash ^= (uint8_t)*str;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/// Stable hash of "suite:test", identifies a unit across runs and machines.
+WINTER_FUNC uint64_t
+_winter_unit_hash(const winter_unit_t* unit) {
+    return _winter_hash(_winter_hash(_winter_hash(WINTER_HASH_SEED, unit->suite->name), ":"), unit->test->name);
+}
+
+// ### HISTORY ########################################################################################################
+
+/// Finds the slot of the hash in the open addressing table, which is either its entry or the empty slot to insert it.
+WINTER_FUNC winter_history_t*
+_winter_history_slot(uint64_t hash) {
+    const size_t mask = _winter.history.capacity - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        winter_history_t* entry = &_winter.history.entries[i];
+        if (entry->hash == hash || entry->hash == 0) {
+            return entry;
+        }
+    }
+}
+
+WINTER_FUNC winter_history_t*
+_winter_history_find(uint64_t hash) {
+    if (_winter.history.capacity == 0) {
+        return nullptr;
+    }
+
+    // zero marks empty slots
+    winter_history_t* entry = _winter_history_slot(hash | 1);
+    return entry->hash != 0 ? entry : nullptr;
+}
+
+WINTER_FUNC winter_history_t*
+_winter_history_insert(uint64_t hash) {
+    hash |= 1;
+
+    if ((_winter.history.length + 1) * 2 > _winter.history.capacity) {
+        const winter_history_t* entries = _winter.history.entries;
+        const size_t capacity = _winter.history.capacity;
+
+        _winter.history.capacity = capacity == 0 ? 64 : capacity * 2;
+        _winter.history.entries = calloc(_winter.history.capacity, sizeof(winter_history_t));
+        if (_winter.history.entries == nullptr) {
+            _winter_fatal_error("History allocation failed (size: %zu)", _winter.history.capacity);
+        }
+
+        for (size_t i = 0; i < capacity; ++i) {
+            if (entries[i].hash != 0) {
+                *_winter_history_slot(entries[i].hash) = entries[i];
+            }
+        }
+
+        free((void*)entries);
+    }
+
+    winter_history_t* entry = _winter_history_slot(hash);
+    if (entry->hash == 0) {
+        entry->hash = hash;
+        _winter.history.length += 1;
+    }
+
+    return entry;
+}
+
+/// Expected duration of a unit in nanoseconds, the mean of its recorded durations or zero if there are none.
+WINTER_FUNC uint64_t
+_winter_history_estimate(const winter_history_t* entry) {
+    if (entry == nullptr || entry->count == 0) {
+        return 0;
+    }
+
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < entry->count; ++i) {
+        sum += entry->durations[i];
+    }
+
+    return sum / entry->count;
+}
+
+/// Timeout of a unit in milliseconds. With --adaptive-timeout and enough recorded durations it is the 99th percentile
+/// of the durations times WINTER_ADAPTIVE_TIMEOUT_FACTOR within the bounds, otherwise the timeout of the test.
+WINTER_FUNC double
+_winter_unit_timeout(const winter_unit_t* unit) {
+    if (!_winter.opts.adaptive_timeout) {
+        return unit->test->timeout;
+    }
+
+    const winter_history_t* entry = _winter_history_find(_winter_unit_hash(unit));
+    if (entry == nullptr || entry->count < WINTER_ADAPTIVE_TIMEOUT_SAMPLES) {
+        return unit->test->timeout;
+    }
+
+    uint64_t durations[WINTER_HISTORY_SAMPLES];
+    for (uint32_t i = 0; i < entry->count; ++i) {
+        uint32_t j = i;
+        for (; j > 0 && durations[j - 1] > entry->durations[i]; --j) {
+            durations[j] = durations[j - 1];
+        }
+        durations[j] = entry->durations[i];
+    }
+
+    // nearest rank, with the few samples of the history this is the slowest recorded run
+    const uint32_t rank = (uint32_t)ceil(0.99 * entry->count);
+    const double timeout = (double)durations[rank - 1] / 1000000.0 * WINTER_ADAPTIVE_TIMEOUT_FACTOR;
+
+    return fmin(fmax(timeout, _winter.opts.timeout_min), _winter.opts.timeout_max);
+}
+
+/// Sorts by descending weight and ascending key.
+WINTER_FUNC int
+_winter_weight_compare(const void* a, const void* b) {
+    const winter_weight_t* x = a;
+    const winter_weight_t* y = b;
+
+    if (x->weight != y->weight) {
+        return x->weight < y->weight ? 1 : -1;
+    }
+
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/// Reads the history file, lines have the format: hash passed|failed count durations... suite:test
+WINTER_FUNC void
+_winter_history_load(void) {
+    FILE* file = fopen(_winter.history.path, "r");
+    if (file == nullptr) {
+        if (errno != ENOENT) {
+            _winter_fatal_error("Failed to open history %s (%s)", _winter.history.path, strerror(errno));
+        }
+        return;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char* it = line;
+        const uint64_t hash = strtoull(it, &it, 16);
+        while (*it == ' ') {
+            it += 1;
+        }
+
+        const bool failed = strncmp(it, "failed", 6) == 0;
+        it = strchr(it, ' ');
+        if (hash == 0 || it == nullptr) {
+            continue;
+        }
+
+        winter_history_t* entry = _winter_history_insert(hash);
+        entry->failed = failed;
+        const uint32_t count = (uint32_t)strtoul(it, &it, 10);
+        entry->count = count < WINTER_HISTORY_SAMPLES ? count : WINTER_HISTORY_SAMPLES;
+
+        for (uint32_t i = 0; i < entry->count; ++i) {
+            entry->durations[i] = strtoull(it, &it, 10);
+        }
+
+        while (*it == ' ') {
+            it += 1;
+        }
+        it[strcspn(it, "\n")] = '\0';
+
+        free(entry->name);
+        entry->name = strdup(it);
+    }
+
+    fclose(file);
+}
+
+WINTER_FUNC void
+_winter_history_record(const winter_unit_t* unit, const bool success) {
+    if (_winter.history.path == nullptr) {
+        return;
+    }
+
+    winter_history_t* entry = _winter_history_insert(_winter_unit_hash(unit));
+    if (entry->name == nullptr) {
+        const size_t length = strlen(unit->suite->name) + strlen(unit->test->name) + 2;
+        entry->name = malloc(length);
+        if (entry->name != nullptr) {
+            snprintf(entry->name, length, "%s:%s", unit->suite->name, unit->test->name);
+        }
+    }
+
+    entry->failed = !success;
+
+    // a killed process only shows that the unit takes longer than its timeout, adaptive timeouts would keep growing
+    if (unit->timed_out) {
+        return;
+    }
+
+    if (entry->count < WINTER_HISTORY_SAMPLES) {
+        entry->count += 1;
+    }
+    memmove(entry->durations + 1, entry->durations, (entry->count - 1) * sizeof(uint64_t));
+    entry->durations[0] = unit->end_time - unit->start_time;
+}
+
+/// Writes the history to a temporary file next to it and renames it, so a crashed run never leaves a broken file.
+WINTER_FUNC void
+_winter_history_save(void) {
+    if (_winter.history.path == nullptr) {
+        return;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.tmp", _winter.history.path);
+
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        _winter_print("Failed to write history %s (%s).\n", path, strerror(errno));
+        return;
+    }
+
+    for (size_t i = 0; i < _winter.history.capacity; ++i) {
+        const winter_history_t* entry = &_winter.history.entries[i];
+        if (entry->hash == 0 || (entry->count == 0 && !entry->failed)) {
+            continue;
+        }
+
+        fprintf(file, "%016jx %s %u", (uintmax_t)entry->hash, entry->failed ? "failed" : "passed", entry->count);
+        for (uint32_t j = 0; j < entry->count; ++j) {
+            fprintf(file, " %ju", (uintmax_t)entry->durations[j]);
+        }
+        fprintf(file, " %s\n", entry->name != nullptr ? entry->name : "");
+    }
+
+    if (fclose(file) != 0 || rename(path, _winter.history.path) != 0) {
+        _winter_print("Failed to write history %s (%s).\n", _winter.history.path, strerror(errno));
+    }
+}
+
+// ### BASELINES ######################################################################################################
+
+WINTER_FUNC winter_baseline_t*
+_winter_baseline_insert(const uint64_t hash) {
+    for (size_t i = 0; i < _winter.baselines.length; ++i) {
+        winter_baseline_t* entry = _winter_array_get(&_winter.baselines, i);
+        if (entry->hash == hash) {
+            return entry;
+        }
+    }
+
+    _winter_array_push(&_winter.baselines, &(winter_baseline_t){ .hash = hash });
+    return _winter_array_get(&_winter.baselines, _winter.baselines.length - 1);
+}
+
+/// Reads a baseline file into the baselines, or into the results if the file is the one results are saved to, so the
+/// results of benchmarks that do not run are kept.
+WINTER_FUNC void
+_winter_baseline_load(const char* path, const bool baseline) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        if (errno != ENOENT || baseline) {
+            _winter_fatal_error("Failed to open benchmark baseline %s (%s)", path, strerror(errno));
+        }
+        return;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char* it = line;
+        const uint64_t hash = strtoull(it, &it, 16);
+
+        winter_bench_stats_t stats = { 0 };
+        stats.count = (uint32_t)strtoul(it, &it, 10);
+        stats.mean = strtod(it, &it);
+        stats.variance = strtod(it, &it);
+        stats.median = strtod(it, &it);
+        if (hash == 0 || stats.count == 0) {
+            continue;
+        }
+
+        while (*it == ' ') {
+            it += 1;
+        }
+        it[strcspn(it, "\n")] = '\0';
+
+        winter_baseline_t* entry = _winter_baseline_insert(hash);
+        if (baseline) {
+            entry->has_baseline = true;
+            entry->baseline = stats;
+        } else {
+            entry->has_result = true;
+            entry->result = stats;
+        }
+
+        if (entry->name == nullptr) {
+            entry->name = strdup(it);
+        }
+    }
+
+    fclose(file);
+}
+
+WINTER_FUNC void
+_winter_baseline_save(void) {
+    if (_winter.opts.bench_save == nullptr) {
+        return;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.tmp", _winter.opts.bench_save);
+
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        _winter_print("Failed to write benchmark baseline %s (%s).\n", path, strerror(errno));
+        return;
+    }
+
+    for (size_t i = 0; i < _winter.baselines.length; ++i) {
+        const winter_baseline_t* entry = _winter_array_get(&_winter.baselines, i);
+        if (!entry->has_result) {
+            continue;
+        }
+
+        const winter_bench_stats_t* stats = &entry->result;
+        fprintf(
+          file,
+          "%016jx %u %.17g %.17g %.17g %s\n",
+          (uintmax_t)entry->hash,
+          stats->count,
+          stats->mean,
+          stats->variance,
+          stats->median,
+          entry->name != nullptr ? entry->name : ""
+        );
+    }
+
+    if (fclose(file) != 0 || rename(path, _winter.opts.bench_save) != 0) {
+        _winter_print("Failed to write benchmark baseline %s (%s).\n", _winter.opts.bench_save, strerror(errno));
+    }
+}
+
+/// Continued fraction of the regularized incomplete beta function, evaluated with the modified Lentz method.
+WINTER_FUNC double
+_winter_beta_fraction(const double a, const double b, const double x) {
+    const double tiny = 1e-300;
+    double c = 1;
+    double d = 1 - (a + b) * x / (a + 1);
+    d = 1 / (fabs(d) < tiny ? tiny : d);
+    double result = d;
+
+    for (int m = 1; m <= 200; ++m) {
+        for (int odd = 0; odd < 2; ++odd) {
+            const double numerator = odd ? -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1))
+                                         : m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+            d = 1 + numerator * d;
+            d = 1 / (fabs(d) < tiny ? tiny : d);
+            c = 1 + numerator / c;
+            c = fabs(c) < tiny ? tiny : c;
+            result *= c * d;
+        }
+
+        if (fabs(c * d - 1) < 1e-12) {
+            break;
+        }
+    }
+
+    return result;
+}
+
+/// Regularized incomplete beta function I_x(a, b).
+WINTER_FUNC double
+_winter_beta_regularized(const double a, const double b, const double x) {
+    if (x <= 0 || x >= 1) {
+        return x <= 0 ? 0 : 1;
+    }
+
+    const double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1 - x));
+    if (x < (a + 1) / (a + b + 2)) {
+        return front * _winter_beta_fraction(a, b, x) / a;
+    }
+
+    return 1 - front * _winter_beta_fraction(b, a, 1 - x) / b;
+}
+
+/// One sided p-value of Welch's t-test for the mean of the result being larger than the mean of the baseline.
+WINTER_FUNC double
+_winter_welch_p_value(const winter_bench_stats_t* baseline, const winter_bench_stats_t* result) {
+    const double a = baseline->variance / baseline->count;
+    const double b = result->variance / result->count;
+    const double diff = result->mean - baseline->mean;
+
+    if (a + b <= 0) {
+        return diff > 0 ? 0 : 1;
+    }
+
+    const double t = diff / sqrt(a + b);
+    const double df_divisor = (baseline->count > 1 ? a * a / (baseline->count - 1) : 0)
+                            + (result->count > 1 ? b * b / (result->count - 1) : 0);
+    const double df = df_divisor > 0 ? (a + b) * (a + b) / df_divisor : 1;
+
+    const double tail = 0.5 * _winter_beta_regularized(df / 2, 0.5, df / (df + t * t));
+    return t > 0 ? tail : 1 - tail;
+}
+
+/// Stores the result of a finished benchmark and compares it with its baseline. Returns false if the benchmark got
+/// significantly slower by more than the threshold.
+WINTER_FUNC bool
+_winter_baseline_check(const winter_unit_t* unit) {
+    if (unit->bench == nullptr || unit->bench->count == 0) {
+        return true;
+    }
+
+    winter_baseline_t* entry = _winter_baseline_insert(_winter_unit_hash(unit));
+    if (entry->name == nullptr) {
+        const size_t length = strlen(unit->suite->name) + strlen(unit->test->name) + 2;
+        entry->name = malloc(length);
+        if (entry->name != nullptr) {
+            snprintf(entry->name, length, "%s:%s", unit->suite->name, unit->test->name);
+        }
+    }
+
+    entry->has_result = true;
+    entry->result = *unit->bench;
+
+    if (_winter.opts.bench_compare == nullptr) {
+        return true;
+    }
+    if (!entry->has_baseline) {
+        _winter_unit_print(unit, WINTER_INDENT "No baseline to compare with.\n");
+        return true;
+    }
+
+    const winter_bench_stats_t* baseline = &entry->baseline;
+    const winter_bench_stats_t* result = &entry->result;
+    const double delta = (result->mean - baseline->mean) / baseline->mean * 100;
+    const double p = _winter_welch_p_value(baseline, result);
+
+    const char* baseline_suffix;
+    const char* result_suffix;
+    const double baseline_mean = _winter_ns_scaled(baseline->mean, &baseline_suffix);
+    const double result_mean = _winter_ns_scaled(result->mean, &result_suffix);
+    _winter_unit_print(
+      unit,
+      WINTER_INDENT "baseline mean %.02f%s, now %.02f%s (%+.02f%%, p = %.4f)\n",
+      baseline_mean,
+      baseline_suffix,
+      result_mean,
+      result_suffix,
+      delta,
+      p
+    );
+
+    if (delta > _winter.opts.bench_threshold && p < WINTER_BENCH_ALPHA) {
+        _winter_unit_print(
+          unit,
+          WINTER_INDENT "Significantly slower than the baseline by more than %.02f%%.\n",
+          _winter.opts.bench_threshold
+        );
+        return false;
+    }
+
+    return true;
+}
+
+// ### PATTERNS #######################################################################################################
+
+/// Builds the index of the suite names, suites with the same name get separate entries next to each other.
+WINTER_FUNC void
+_winter_index_build(void) {
+    _winter.index.capacity = 16;
+    while (_winter.index.capacity < _winter.suites.length * 2) {
+        _winter.index.capacity *= 2;
+    }
+
+    _winter.index.hashes = calloc(_winter.index.capacity, sizeof(uint64_t));
+    _winter.index.suites = calloc(_winter.index.capacity, sizeof(size_t));
+    if (_winter.index.hashes == nullptr || _winter.index.suites == nullptr) {
+        _winter_fatal_error("Index allocation failed (suites: %zu)", _winter.suites.length);
+    }
+
+    const size_t mask = _winter.index.capacity - 1;
+    for (size_t i = 0; i < _winter.suites.length; ++i) {
+        const winter_suite_t* suite = _winter_array_get(&_winter.suites, i);
+        const uint64_t hash = _winter_hash(WINTER_HASH_SEED, suite->name) | 1;
+
+        size_t slot = hash & mask;
+        while (_winter.index.hashes[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+
+        _winter.index.hashes[slot] = hash;
+        _winter.index.suites[slot] = i;
+    }
+}
+
+/// Finds the next suite named by the pattern, starting at the slot which is initially the hash of the suite name.
+/// Returns nullptr when there are no more.
+WINTER_FUNC winter_suite_t*
+_winter_index_next(const winter_pattern_t* pattern, size_t* slot) {
+    const size_t mask = _winter.index.capacity - 1;
+    const uint64_t hash = pattern->suite_hash | 1;
+
+    for (; _winter.index.hashes[*slot & mask] != 0; *slot += 1) {
+        const size_t i = *slot & mask;
+        if (_winter.index.hashes[i] != hash) {
+            continue;
+        }
+
+        winter_suite_t* suite = _winter_array_get(&_winter.suites, _winter.index.suites[i]);
+        if (strcmp(suite->name, pattern->suite) == 0) {
+            *slot += 1;
+            return suite;
+        }
+    }
+
+    return nullptr;
+}
+
+WINTER_FUNC void
+_winter_exact_insert(const winter_pattern_t* pattern) {
+    if ((_winter.exact.length + 1) * 2 > _winter.exact.capacity) {
+        uint64_t* hashes = _winter.exact.hashes;
+        const winter_pattern_t** patterns = _winter.exact.patterns;
+        const size_t capacity = _winter.exact.capacity;
+
+        _winter.exact.capacity = capacity == 0 ? 16 : capacity * 2;
+        _winter.exact.hashes = calloc(_winter.exact.capacity, sizeof(uint64_t));
+        _winter.exact.patterns = calloc(_winter.exact.capacity, sizeof(winter_pattern_t*));
+        if (_winter.exact.hashes == nullptr || _winter.exact.patterns == nullptr) {
+            _winter_fatal_error("Pattern allocation failed (size: %zu)", _winter.exact.capacity);
+        }
+
+        _winter.exact.length = 0;
+        for (size_t i = 0; i < capacity; ++i) {
+            if (hashes[i] != 0) {
+                _winter_exact_insert(patterns[i]);
+            }
+        }
+
+        free(hashes);
+        free(patterns);
+    }
+
+    const size_t mask = _winter.exact.capacity - 1;
+    size_t slot = pattern->hash & mask;
+    while (_winter.exact.hashes[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+
+    _winter.exact.hashes[slot] = pattern->hash;
+    _winter.exact.patterns[slot] = pattern;
+    _winter.exact.length += 1;
+}
+
+/// Whether a pattern without glob characters names the unit, hash collisions are resolved by comparing the names.
+WINTER_FUNC bool
+_winter_exact_contains(const winter_unit_t* unit) {
+    if (_winter.exact.length == 0) {
+        return false;
+    }
+
+    const uint64_t hash = _winter_unit_hash(unit) | 1;
+    const size_t mask = _winter.exact.capacity - 1;
+
+    for (size_t slot = hash & mask; _winter.exact.hashes[slot] != 0; slot = (slot + 1) & mask) {
+        const winter_pattern_t* pattern = _winter.exact.patterns[slot];
+        if (_winter.exact.hashes[slot] != hash) {
+            continue;
+        }
+        if (strcmp(pattern->suite, unit->suite->name) == 0 && strcmp(pattern->test, unit->test->name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Splits the pattern into its suite and test part.
+WINTER_FUNC winter_pattern_t*
+_winter_pattern_compile(const char* text) {
+    winter_pattern_t* pattern = calloc(1, sizeof(winter_pattern_t));
+    if (pattern == nullptr) {
+        _winter_fatal_error("Pattern allocation failed (pattern: %s)", text);
+    }
+
+    const char* separator = strchr(text, ':');
+    const size_t length = separator ? (size_t)(separator - text) : strlen(text);
+
+    pattern->suite = strndup(text, length);
+    if (pattern->suite == nullptr) {
+        _winter_fatal_error("Pattern allocation failed (pattern: %s)", text);
+    }
+
+    pattern->suite_hash = _winter_hash(WINTER_HASH_SEED, pattern->suite);
+
+    if (separator != nullptr) {
+        pattern->test = separator + 1;
+        pattern->glob = strpbrk(pattern->test, "*?[\\") != nullptr;
+        pattern->hash = _winter_hash(_winter_hash(pattern->suite_hash, ":"), pattern->test) | 1;
+    }
+
+    if (_winter.index.capacity == 0) {
+        _winter_index_build();
+    }
+
+    return pattern;
+}
+
+/// Compiles a pattern of the command line and marks the suites and tests it selects.
+WINTER_FUNC void
+_winter_pattern_add(const char* text) {
+    winter_pattern_t* pattern = _winter_pattern_compile(text);
+    _winter_array_push(&_winter.patterns, &pattern);
+
+    winter_suite_t* suite;
+    for (size_t slot = pattern->suite_hash | 1; (suite = _winter_index_next(pattern, &slot)) != nullptr;) {
+        suite->matched = true;
+
+        if (pattern->test == nullptr) {
+            suite->match_all = true;
+        } else if (pattern->glob) {
+            if (suite->globs.element_size == 0) {
+                _winter_array_init(&suite->globs, sizeof(winter_pattern_t*));
+            }
+            _winter_array_push(&suite->globs, &pattern);
+        }
+    }
+
+    if (pattern->test != nullptr && !pattern->glob) {
+        _winter_exact_insert(pattern);
+    }
+}
+
+WINTER_FUNC bool
+_winter_pattern_match_test(const winter_pattern_t* pattern, const char* name) {
+    if (pattern->test == nullptr) {
+        return true;
+    }
+    if (!pattern->glob) {
+        return strcmp(pattern->test, name) == 0;
+    }
+
+    const int ret = fnmatch(pattern->test, name, 0);
+
+    if (ret == 0) {
+        return true;
+    }
+    if (ret == FNM_NOMATCH) {
+        return false;
+    }
+
+    _winter_fatal_error("Failed to match pattern: %s:%s", pattern->suite, pattern->test);
+}
+
+WINTER_FUNC winter_unit_t
+_winter_find_test(const char* text) {
+    const winter_pattern_t* pattern = _winter_pattern_compile(text);
+
+    const winter_suite_t* suite;
+    for (size_t slot = pattern->suite_hash | 1; (suite = _winter_index_next(pattern, &slot)) != nullptr;) {
+        for (size_t j = 0; j < suite->tests.length; ++j) {
+            const winter_test_t* test = _winter_array_get(&suite->tests, j);
+            if (!_winter_pattern_match_test(pattern, test->name)) {
+                continue;
+            }
+
+            return (winter_unit_t){
+                .start_time = _winter_now(),
+                .timeout = test->timeout,
+                .suite = suite,
+                .test = test,
+            };
+        }
+    }
+
+    _winter_fatal_error("No test found for pattern: %s", text);
+}
+
+WINTER_FUNC void
+_winter_list(void) {
+    _winter_print(WINTER_COLOR_BOLD "\nTest suites:\n" WINTER_COLOR_RESET);
+
+    size_t total_tests = 0;
+    for (size_t i = 0; i < _winter.suites.length; ++i) {
+        const winter_suite_t* suite = _winter_array_get(&_winter.suites, i);
+        _winter_print(WINTER_COLOR_DESC "%s:" WINTER_COLOR_RESET " %ji tests\n", suite->name, suite->tests.length);
+        total_tests += suite->tests.length;
+    }
+
+    _winter_print(WINTER_COLOR_BOLD "\nTotal: %ji tests.\n" WINTER_COLOR_RESET, total_tests);
+}
+
+WINTER_FUNC void
+_winter_debug(const char* pattern) {
+    winter_unit_t unit = _winter_find_test(pattern);
+    unit.suite->func(WINTER_FUNC_BEFORE_ALL);
+
+    while (true) {
+        if (_winter_unit_debug(&unit)) {
+            break;
+        }
+    }
+
+    unit.suite->func(WINTER_FUNC_AFTER_ALL);
+}
+
+#define _winter_print_usage(path, u, d) fprintf(stdout, "  %s %-21s %s.\n", path, u, d);
+
+// width of the option column, the longest option and a space fit into it
+#define _WINTER_HELP_WIDTH 30
+
+#define _winter_print_opt_flag(n, sn, expl, d)                                                                         \
+    fprintf(stdout, "  %-*s%s.\n", _WINTER_HELP_WIDTH, "--[no-]" n " | -" sn, expl);                                   \
+    fprintf(stdout, "  %-*sDefault: %s.\n", _WINTER_HELP_WIDTH, "", d)
+
+#define _winter_print_opt_str(n, sn, expl, d)                                                                          \
+    fprintf(stdout, "  %-*s%s.\n", _WINTER_HELP_WIDTH, "--" n " | -" sn " value", expl);                               \
+    fprintf(stdout, "  %-*sDefault: %s.\n", _WINTER_HELP_WIDTH, "", d)
+
+WINTER_FUNC void
+_winter_print_help(const char* path) {
+    fprintf(stdout, "Usages:\n");
+    _winter_print_usage(path, "[options] [patterns]", "Run all tests that match the patterns");
+    _winter_print_usage(path, "--help | -h", "Print this help text and exit");
+    _winter_print_usage(path, "--version | -v", "Print version and exit");
+    _winter_print_usage(path, "--list | -l", "Print a list of all available tests");
+    _winter_print_usage(path, "--debug pattern", "Run one test and wait for a debugger to attach to the test");
+
+    fprintf(stdout, "\nOptions:\n");
+    _winter_print_opt_flag("color", "c", "Whether to print output in color", "on when output is TTY");
+    _winter_print_opt_flag("rerun", "r", "Rerun failed test and wait for a debugger to attach to the test", "off");
+    _winter_print_opt_flag("pid", "p", "Print the pid of the test process", "off");
+    _winter_print_opt_flag("timeout", "t", "Whether to fail a test after its timeout", "on");
+    _winter_print_opt_flag("bench", "b", "Run the benchmarks instead of the tests", "off");
+    _winter_print_opt_str("jobs", "j", "Number of tests to run at the same time, 0 for one per CPU", "1");
+    _winter_print_opt_str("reporter", "R", "Output format, one of text, json (one record per line) or junit", "text");
+    _winter_print_opt_str("barrier", "B", "Implementation of synchronize(), one of mutex or spin", "mutex");
+    _winter_print_opt_str("affinity", "A", "Pin test threads: spread, compact or a CPU list like 0,2,4-7", "none");
+    _winter_print_opt_str("shard", "s", "Only run the i-th of n disjoint subsets of the tests, given as i/n", "1/1");
+    _winter_print_opt_str("history", "H", "File with durations and outcomes of previous runs", "none");
+    _winter_print_opt_flag("weighted", "w", "Balance shards by the durations in the history instead of by hash", "off");
+    _winter_print_opt_flag("failed-first", "f", "Run the tests that failed in the history before all others", "off");
+    _winter_print_opt_flag("only-failed", "o", "Only run the tests that failed in the history", "off");
+    _winter_print_opt_flag("batch", "a", "Run many units per process, forking again after a unit failed", "off");
+    _winter_print_opt_flag("counters", "P", "Report hardware counters of every test on Linux, if permitted", "off");
+    _winter_print_opt_str("bench-save", "S", "File the benchmark results are stored in as a baseline", "none");
+    _winter_print_opt_str("bench-compare", "C", "Baseline to compare benchmarks with, slowdowns fail", "none");
+    _winter_print_opt_str("bench-threshold", "T", "Slowdown in percent a benchmark may have", "5");
+    _winter_print_opt_str("seed", "e", "Seed of the first case of every property, printed when one fails", "random");
+    _winter_print_opt_flag("adaptive-timeout", "d", "Derive timeouts from the slowest durations in the history", "off");
+    _winter_print_opt_str("timeout-bounds", "m", "Adaptive timeouts in milliseconds, given as min:max", "100:60000");
+    _winter_print_opt_str("repeat", "n", "Run the body of every test this many times in one process", "1");
+    _winter_print_opt_str("stress", "x", "Repeat the body of every test for this many seconds", "off");
+    _winter_print_opt_str("jitter", "J", "Random delay of up to this many microseconds before synchronize()", "0");
+}
+
+#define _winter_opt_flag(opt, n, sn)                                                                                   \
+    opt.name = n;                                                                                                      \
+    opt.short_name = sn;                                                                                               \
+    opt.is_flag = true;                                                                                                \
+    opt.bool_val = false;                                                                                              \
+    opt.overwritten = false
+
+#define _winter_opt_str(opt, n, sn)                                                                                    \
+    opt.name = n;                                                                                                      \
+    opt.short_name = sn;                                                                                               \
+    opt.is_flag = false;                                                                                               \
+    opt.str_val = nullptr;                                                                                             \
+    opt.overwritten = false
+
+#define _winter_opt_default(opt, val)                                                                                  \
+    if (!opt.overwritten)                                                                                              \
+    opt.bool_val = val
+
+WINTER_FUNC void
+_winter_parse_seed(const char* value) {
+    if (value == nullptr) {
+        return;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    const unsigned long long seed = strtoull(value, &end, 0);
+    if (errno != 0 || end == value || *end != '\0') {
+        _winter_fatal_error("Invalid seed: %s", value);
+    }
+
+    _winter.opts.seeded = true;
+    _winter.opts.seed = seed;
+}
+
+WINTER_FUNC double
+_winter_parse_threshold(const char* value) {
+    if (value == nullptr) {
+        return WINTER_BENCH_THRESHOLD;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    const double threshold = strtod(value, &end);
+    if (errno != 0 || end == value || *end != '\0' || !(threshold >= 0)) {
+        _winter_fatal_error("Invalid benchmark threshold: %s", value);
+    }
+
+    return threshold;
+}
+
+WINTER_FUNC uint32_t
+_winter_parse_jobs(const char* value) {
+    if (value == nullptr) {
+        return 1;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    const unsigned long jobs = strtoul(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || jobs > UINT16_MAX) {
+        _winter_fatal_error("Invalid number of jobs: %s", value);
+    }
+
+    if (jobs == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return cpus > 0 ? (uint32_t)cpus : 1;
+    }
+
+    return (uint32_t)jobs;
+}
+
+WINTER_FUNC winter_reporter_t
+_winter_parse_reporter(const char* value) {
+    if (value == nullptr || strcmp(value, "text") == 0) {
+        return WINTER_REPORTER_TEXT;
+    }
+    if (strcmp(value, "json") == 0) {
+        return WINTER_REPORTER_JSON;
+    }
+    if (strcmp(value, "junit") == 0) {
+        return WINTER_REPORTER_JUNIT;
+    }
+
+    _winter_fatal_error("Unknown reporter: %s", value);
+}
+
+WINTER_FUNC winter_barrier_t
+_winter_parse_barrier(const char* value) {
+    if (value == nullptr || strcmp(value, "mutex") == 0) {
+        return WINTER_BARRIER_MUTEX;
+    }
+    if (strcmp(value, "spin") == 0) {
+        return WINTER_BARRIER_SPIN;
+    }
+
+    _winter_fatal_error("Unknown barrier: %s", value);
+}
+
+/// Parses a positive number of the unit, like the iterations of --repeat or the seconds of --stress, into the scale.
+WINTER_FUNC uint64_t
+_winter_parse_amount(const char* name, const char* value, const double scale) {
+    if (value == nullptr) {
+        return 0;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    const double amount = strtod(value, &end);
+    if (errno != 0 || end == value || *end != '\0' || !(amount > 0) || amount * scale >= 0x1p64) {
+        _winter_fatal_error("Invalid %s: %s", name, value);
+    }
+
+    return (uint64_t)(amount * scale);
+}
+
+WINTER_FUNC void
+_winter_parse_timeout_bounds(const char* value) {
+    _winter.opts.timeout_min = WINTER_ADAPTIVE_TIMEOUT_MIN_MS;
+    _winter.opts.timeout_max = WINTER_ADAPTIVE_TIMEOUT_MAX_MS;
+
+    if (value == nullptr) {
+        return;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    const double min = strtod(value, &end);
+    if (errno != 0 || end == value || *end != ':') {
+        _winter_fatal_error("Invalid timeout bounds, expected min:max: %s", value);
+    }
+
+    const char* max_str = end + 1;
+    const double max = strtod(max_str, &end);
+    if (errno != 0 || end == max_str || *end != '\0' || !(min > 0) || !(max >= min)) {
+        _winter_fatal_error("Invalid timeout bounds, expected min:max with 0 < min <= max: %s", value);
+    }
+
+    _winter.opts.timeout_min = min;
+    _winter.opts.timeout_max = max;
+}
+
+WINTER_FUNC void
+_winter_parse_shard(const char* value) {
+    _winter.opts.shard_index = 0;
+    _winter.opts.shard_count = 1;
+
+    if (value == nullptr) {
+        return;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    const unsigned long index = strtoul(value, &end, 10);
+    if (errno != 0 || end == value || *end != '/') {
+        _winter_fatal_error("Invalid shard, expected i/n: %s", value);
+    }
+
+    const char* count_str = end + 1;
+    const unsigned long count = strtoul(count_str, &end, 10);
+    if (errno != 0 || end == count_str || *end != '\0' || index < 1 || index > count || count > UINT32_MAX) {
+        _winter_fatal_error("Invalid shard, expected i/n with 1 <= i <= n: %s", value);
+    }
+
+    _winter.opts.shard_index = (uint32_t)index - 1;
+    _winter.opts.shard_count = (uint32_t)count;
+}
+
+WINTER_FUNC void
+_winter_parse_args(const int argc, const char** argv) {
+    _winter_opt_t opts[_WINTER_OPT_LAST];
+
+    _winter_opt_flag(opts[_WINTER_OPT_VERSION], "version", 'v');
+    _winter_opt_flag(opts[_WINTER_OPT_HELP], "help", 'h');
+    _winter_opt_flag(opts[_WINTER_OPT_LIST], "list", 'l');
+    _winter_opt_flag(opts[_WINTER_OPT_COLOR], "color", 'c');
+    _winter_opt_flag(opts[_WINTER_OPT_RERUN], "rerun", 'r');
+    _winter_opt_flag(opts[_WINTER_OPT_TIMEOUT], "timeout", 't');
+    _winter_opt_flag(opts[_WINTER_OPT_BENCH], "bench", 'b');
+    _winter_opt_flag(opts[_WINTER_OPT_WEIGHTED], "weighted", 'w');
+    _winter_opt_flag(opts[_WINTER_OPT_FAILED_FIRST], "failed-first", 'f');
+    _winter_opt_flag(opts[_WINTER_OPT_ONLY_FAILED], "only-failed", 'o');
+    _winter_opt_flag(opts[_WINTER_OPT_COUNTERS], "counters", 'P');
+    _winter_opt_flag(opts[_WINTER_OPT_BATCH], "batch", 'a');
+
+    _winter_opt_str(opts[_WINTER_OPT_DEBUG], "debug", '\0');
+    _winter_opt_str(opts[_WINTER_OPT_JOBS], "jobs", 'j');
+    _winter_opt_str(opts[_WINTER_OPT_REPORTER], "reporter", 'R');
+    _winter_opt_str(opts[_WINTER_OPT_BARRIER], "barrier", 'B');
+    _winter_opt_str(opts[_WINTER_OPT_AFFINITY], "affinity", 'A');
+    _winter_opt_str(opts[_WINTER_OPT_SHARD], "shard", 's');
+    _winter_opt_str(opts[_WINTER_OPT_HISTORY], "history", 'H');
+    _winter_opt_str(opts[_WINTER_OPT_BENCH_SAVE], "bench-save", 'S');
+    _winter_opt_str(opts[_WINTER_OPT_BENCH_COMPARE], "bench-compare", 'C');
+    _winter_opt_str(opts[_WINTER_OPT_BENCH_THRESHOLD], "bench-threshold", 'T');
+    _winter_opt_str(opts[_WINTER_OPT_SEED], "seed", 'e');
+    _winter_opt_flag(opts[_WINTER_OPT_ADAPTIVE_TIMEOUT], "adaptive-timeout", 'd');
+    _winter_opt_str(opts[_WINTER_OPT_TIMEOUT_BOUNDS], "timeout-bounds", 'm');
+    _winter_opt_str(opts[_WINTER_OPT_REPEAT], "repeat", 'n');
+    _winter_opt_str(opts[_WINTER_OPT_STRESS], "stress", 'x');
+    _winter_opt_str(opts[_WINTER_OPT_JITTER], "jitter", 'J');
+
+    // the suites are only loaded once the options are known, --help and --version do not need them
+    const char* patterns[argc];
+    int pattern_count = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+
+        if (arg[0] != '-') {
+            patterns[pattern_count++] = arg;
+            continue;
+        }
+
+        const bool is_long = arg[1] == '-';
+        const char* name = is_long ? arg + 2 : arg + 1;
+        const bool inverted = is_long && strncmp(name, "no-", 3) == 0;
+
+        if (inverted) {
+            name += 3;
+        }
+
+        // long options accept their value after an equal sign: --name=value
+        const char* value = is_long ? strchr(name, '=') : nullptr;
+        const size_t length = value != nullptr ? (size_t)(value - name) : strlen(name);
+
+        bool valid = false;
+        for (uint32_t j = 0; j < _WINTER_OPT_LAST; ++j) {
+            _winter_opt_t* opt = &opts[j];
+
+            if (is_long) {
+                valid = strlen(opt->name) == length && strncmp(opt->name, name, length) == 0;
+            } else {
+                valid = opt->short_name != '\0' && opt->short_name == name[0];
+            }
+            if (!valid) {
+                continue;
+            }
+
+            opt->overwritten = true;
+
+            if (opt->is_flag) {
+                if (value != nullptr) {
+                    _winter_fatal_error("Option %s does not take an argument", arg);
+                }
+
+                opt->bool_val = !inverted;
+            } else if (value != nullptr) {
+                opt->str_val = value + 1;
+            } else if (!is_long && name[1] != '\0') {
+                opt->str_val = name + 1;
+            } else {
+                if (++i >= argc) {
+                    _winter_fatal_error("Option %s requires an argument", arg);
+                }
+
+                opt->str_val = argv[i];
+            }
+
+            break;
+        }
+
+        if (!valid) {
+            _winter_fatal_error("Unknown option: %s", arg);
+        }
     }
 
-    if (waitpid(pid, nullptr, 0) == -1) {
-        _winter_print(WINTER_INDENT "Waiting for terminated process failed (%s).\n", strerror(errno));
+    if (opts[_WINTER_OPT_HELP].bool_val) {
+        _winter_print_help(argv[0]);
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+    if (opts[_WINTER_OPT_VERSION].bool_val) {
+        fprintf(stdout, "Winter %s\n", WINTER_VERSION);
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
     }
-}
 
-WINTER_FUNC bool
-_winter_unit_debug(winter_unit_t* unit) {
-    const pid_t pid = fork();
-    if (pid == 0) {
-        raise(SIGSTOP);
-        _winter_process_entry(unit);
-        _exit(0);
+    _winter_suites_load();
+    for (int i = 0; i < pattern_count; ++i) {
+        _winter_pattern_add(patterns[i]);
     }
 
-    signal(SIGINT, _winter_debug_handler);
-    _winter_debug_abort = false;
+    if (opts[_WINTER_OPT_LIST].bool_val) {
+        _winter_list();
+        _exit(EXIT_SUCCESS);
+    }
 
-    _winter_print(WINTER_INDENT "Waiting for debugger to attach, press ctrl-c to abort... (pid %d)\n", pid);
+    // a failing case can be reproduced in the debugger as well
+    _winter_parse_seed(opts[_WINTER_OPT_SEED].str_val);
 
-    while (true) {
-        const pid_t ret = waitpid(pid, nullptr, WNOHANG);
+    if (opts[_WINTER_OPT_DEBUG].str_val != nullptr) {
+        _winter_debug(opts[_WINTER_OPT_DEBUG].str_val);
+        _exit(EXIT_SUCCESS);
+    }
 
-        if (ret == pid) {
-            _winter_print(WINTER_INDENT "Test process exited. Restarting test.\n");
-            break;
-        }
+    const bool is_tty = isatty(fileno(_winter.print.file));
+    const bool no_color = getenv("NO_COLOR") != nullptr;
+    _winter_opt_default(opts[_WINTER_OPT_COLOR], is_tty && !no_color);
+    _winter_opt_default(opts[_WINTER_OPT_TIMEOUT], true);
 
-        if (_winter_debug_abort) {
-            _winter_kill_process(pid);
-            _winter_print("\r" WINTER_INDENT "Waiting aborted by user.\n");
-            break;
-        }
+    _winter.opts.list = opts[_WINTER_OPT_LIST].bool_val;
+    _winter.opts.color = opts[_WINTER_OPT_COLOR].bool_val;
+    _winter.opts.rerun = opts[_WINTER_OPT_RERUN].bool_val;
+    _winter.opts.timeout = opts[_WINTER_OPT_TIMEOUT].bool_val;
+    _winter.opts.bench = opts[_WINTER_OPT_BENCH].bool_val;
+    _winter.opts.jobs = _winter_parse_jobs(opts[_WINTER_OPT_JOBS].str_val);
+    _winter.opts.reporter = _winter_parse_reporter(opts[_WINTER_OPT_REPORTER].str_val);
+    _winter.opts.barrier = _winter_parse_barrier(opts[_WINTER_OPT_BARRIER].str_val);
+    _winter.opts.affinity = opts[_WINTER_OPT_AFFINITY].str_val;
+
+    // reject invalid lists before any test runs
+    int affinity;
+    _winter_affinity_resolve(_winter.opts.affinity, 1, &affinity);
+    _winter_parse_shard(opts[_WINTER_OPT_SHARD].str_val);
+    _winter.opts.weighted = opts[_WINTER_OPT_WEIGHTED].bool_val;
+    _winter.opts.failed_first = opts[_WINTER_OPT_FAILED_FIRST].bool_val;
+    _winter.opts.only_failed = opts[_WINTER_OPT_ONLY_FAILED].bool_val;
+
+    _winter.opts.counters = opts[_WINTER_OPT_COUNTERS].bool_val;
+    _winter.opts.batch = opts[_WINTER_OPT_BATCH].bool_val;
+    _winter.opts.repeat = _winter_parse_amount("repeat count", opts[_WINTER_OPT_REPEAT].str_val, 1);
+    _winter.opts.stress_ns = _winter_parse_amount("stress duration", opts[_WINTER_OPT_STRESS].str_val, 1e9);
+    _winter.opts.jitter_ns = _winter_parse_amount("jitter", opts[_WINTER_OPT_JITTER].str_val, 1e3);
+    _winter.opts.bench_save = opts[_WINTER_OPT_BENCH_SAVE].str_val;
+    _winter.opts.bench_compare = opts[_WINTER_OPT_BENCH_COMPARE].str_val;
+    _winter.opts.bench_threshold = _winter_parse_threshold(opts[_WINTER_OPT_BENCH_THRESHOLD].str_val);
+    if (_winter.opts.bench_compare != nullptr) {
+        _winter_baseline_load(_winter.opts.bench_compare, true);
+    }
+    if (_winter.opts.bench_save != nullptr) {
+        _winter_baseline_load(_winter.opts.bench_save, false);
+    }
 
-        if (ret == -1 && errno != EINTR && errno != ECHILD) {
-            _winter_print(WINTER_INDENT "Waiting for debug process failed (%s).\n", strerror(errno));
-            break;
-        }
+    _winter.opts.adaptive_timeout = opts[_WINTER_OPT_ADAPTIVE_TIMEOUT].bool_val;
+    _winter_parse_timeout_bounds(opts[_WINTER_OPT_TIMEOUT_BOUNDS].str_val);
+
+    _winter.history.path = opts[_WINTER_OPT_HISTORY].str_val;
+    if (_winter.history.path != nullptr) {
+        _winter_history_load();
+    } else if (_winter.opts.failed_first || _winter.opts.only_failed || _winter.opts.adaptive_timeout) {
+        const char* name = _winter.opts.failed_first ? "failed-first"
+                           : _winter.opts.only_failed ? "only-failed"
+                                                      : "adaptive-timeout";
+        _winter_fatal_error("Option --%s requires --history", name);
+    }
 
-        _winter_sleep_ms(WINTER_PROCESS_POLL_MS);
+    // machine readable output goes to stdout, so it can be redirected on its own
+    if (_winter.opts.reporter != WINTER_REPORTER_TEXT) {
+        _winter.print.file = stdout;
     }
 
-    signal(SIGINT, SIG_DFL);
+    // the runner is the only writer, it flushes a unit with its captured output at once
+    static char buffer[WINTER_OUTPUT_BUFFER_SIZE];
+    setvbuf(_winter.print.file, buffer, _IOFBF, sizeof(buffer));
 
-    return _winter_debug_abort;
+    // rerunning attaches a debugger to the failed test, which only works while no other test is running and
+    // benchmarks running at the same time would disturb each other's measurements
+    if (_winter.opts.rerun || _winter.opts.bench) {
+        _winter.opts.jobs = 1;
+    }
+
+    // a repeated unit already stays in its process, its iterations are reported like one unit
+    if (_winter.opts.repeat > 1 || _winter.opts.stress_ns != 0 || _winter.opts.jitter_ns != 0) {
+        _winter.opts.batch = false;
+    }
 }
 
 WINTER_FUNC bool
-_winter_unit_execute(winter_unit_t* unit) {
-    const pid_t pid = fork();
-    if (pid == 0) {
-        _winter_process_entry(unit);
-        _exit(0);
-    }
+_winter_is_suite_enabled(const winter_suite_t* suite) {
+    return _winter.patterns.length == 0 || suite->matched;
+}
 
-    int status = 0;
-    while (true) {
-        const pid_t ret = waitpid(pid, &status, WNOHANG);
+WINTER_FUNC bool
+_winter_is_unit_failed(const winter_unit_t* unit) {
+    const winter_history_t* entry = _winter_history_find(_winter_unit_hash(unit));
+    return entry != nullptr && entry->failed;
+}
 
-        // child process exited
-        if (ret == pid) {
-            break;
+/// Whether the unit matches the mode of the run and one of the patterns.
+WINTER_FUNC bool
+_winter_is_unit_selected(const winter_unit_t* unit) {
+    if (unit->test->bench != _winter.opts.bench) {
+        return false;
+    }
+    if (_winter.opts.only_failed && !_winter_is_unit_failed(unit)) {
+        return false;
+    }
+    if (_winter.patterns.length == 0 || unit->suite->match_all) {
+        return true;
+    }
+    if (!unit->suite->matched) {
+        return false;
+    }
+    if (_winter_exact_contains(unit)) {
+        return true;
+    }
+
+    for (size_t i = 0; i < unit->suite->globs.length; ++i) {
+        const winter_pattern_t** pattern = _winter_array_get(&unit->suite->globs, i);
+        if (_winter_pattern_match_test(*pattern, unit->test->name)) {
+            return true;
         }
+    }
 
-        // no status reported by child process
-        if (ret == 0) {
-            if (_winter.opts.timeout && _winter_now() - unit->start_time > unit->test->timeout) {
-                _winter_kill_process(pid);
-                _winter_print(WINTER_INDENT "Process timed out after %.0fs.\n", (unit->test->timeout / 1000));
-                return false;
+    return false;
+}
+
+/// Assigns every selected unit to a shard by longest processing time first: units sorted by their recorded duration
+/// go to the shard with the least total duration so far. Units without history weigh as much as the average unit.
+/// Only depends on the history file and the arguments, so every node computes the same assignment.
+WINTER_FUNC void
+_winter_shard_balance(void) {
+    winter_array_t units;
+    _winter_array_init(&units, sizeof(winter_weight_t));
+
+    uint64_t known_sum = 0;
+    uint64_t known_count = 0;
+
+    for (size_t i = 0; i < _winter.suites.length; ++i) {
+        const winter_suite_t* suite = _winter_array_get(&_winter.suites, i);
+
+        for (size_t j = 0; j < suite->tests.length; ++j) {
+            const winter_unit_t unit = { .suite = suite, .test = _winter_array_get(&suite->tests, j) };
+            if (!_winter_is_unit_selected(&unit)) {
+                continue;
             }
 
-            _winter_sleep_ms(WINTER_PROCESS_POLL_MS);
+            const winter_weight_t weight = {
+                .key = _winter_unit_hash(&unit),
+                .weight = _winter_history_estimate(_winter_history_find(_winter_unit_hash(&unit))),
+            };
+            _winter_array_push(&units, &weight);
+
+            known_sum += weight.weight;
+            known_count += weight.weight != 0 ? 1 : 0;
         }
+    }
 
-        if (ret == -1 && errno != EINTR) {
-            _winter_print(WINTER_INDENT "Waiting for process failed (%s).\n", strerror(errno));
-            return false;
+    const uint64_t fallback = known_count != 0 ? known_sum / known_count : 1;
+    for (size_t i = 0; i < units.length; ++i) {
+        winter_weight_t* weight = _winter_array_get(&units, i);
+        if (weight->weight == 0) {
+            weight->weight = fallback;
         }
     }
 
-    if (WIFEXITED(status)) {
-        const int code = WEXITSTATUS(status);
-        if (code != 0) {
-            if (code != WINTER_EXIT_FAILURE) {
-                _winter_print(WINTER_INDENT "Process exited with code %d.\n", code);
-            }
+    qsort(units.elements, units.length, sizeof(winter_weight_t), _winter_weight_compare);
 
-            return false;
+    uint64_t* loads = calloc(_winter.opts.shard_count, sizeof(uint64_t));
+    if (loads == nullptr) {
+        _winter_fatal_error("Shard allocation failed (shards: %u)", _winter.opts.shard_count);
+    }
+
+    for (size_t i = 0; i < units.length; ++i) {
+        const winter_weight_t* weight = _winter_array_get(&units, i);
+
+        uint32_t shard = 0;
+        for (uint32_t k = 1; k < _winter.opts.shard_count; ++k) {
+            if (loads[k] < loads[shard]) {
+                shard = k;
+            }
         }
-    } else if (WIFSIGNALED(status)) {
-        const int sig = WTERMSIG(status);
-        _winter_print(WINTER_INDENT "Process terminated by signal %d (%s).\n", sig, strsignal(sig));
-        return false;
-    } else {
-        _winter_print(WINTER_INDENT "Process ended abnormally (status=0x%x).\n", status);
-        return false;
+
+        loads[shard] += weight->weight;
+        _winter_history_insert(weight->key)->shard = shard;
     }
 
-    return true;
+    free(loads);
+    free(units.elements);
 }
 
 WINTER_FUNC bool
-_winter_pattern_match_suite(const char* pattern, const char* name) {
-    const char* separator = strchr(pattern, ':');
-    const size_t length = separator ? (size_t)(separator - pattern) : strlen(pattern);
+_winter_is_unit_in_shard(const winter_unit_t* unit) {
+    if (_winter.opts.shard_count == 1) {
+        return true;
+    }
+
+    if (_winter.opts.weighted) {
+        const winter_history_t* entry = _winter_history_find(_winter_unit_hash(unit));
+        return entry != nullptr && entry->shard == _winter.opts.shard_index;
+    }
 
-    return length == strlen(name) && strncmp(name, pattern, length) == 0;
+    return _winter_unit_hash(unit) % _winter.opts.shard_count == _winter.opts.shard_index;
 }
 
 WINTER_FUNC bool
-_winter_pattern_match_test(const char* pattern, const char* name) {
-    const char* separator = strchr(pattern, ':');
-    if (separator == nullptr) {
-        return true;
+_winter_is_unit_enabled(const winter_unit_t* unit) {
+    return _winter_is_unit_selected(unit) && _winter_is_unit_in_shard(unit);
+}
+
+/// Order in which the units of a suite are started. With --failed-first the units that failed in the history start
+/// before all others. With several jobs and a history the longest units start first, so the slowest unit does not
+/// start last and keep the suite running long after the other jobs ran out of work. Units without history start before
+/// all others, as nothing is known about them.
+WINTER_FUNC winter_weight_t*
+_winter_suite_order(const winter_suite_t* suite) {
+    winter_weight_t* order = malloc((suite->tests.length + 1) * sizeof(winter_weight_t));
+    if (order == nullptr) {
+        _winter_fatal_error("Order allocation failed (tests: %zu)", suite->tests.length);
     }
 
-    const int ret = fnmatch(separator + 1, name, 0);
+    const bool by_duration = _winter.opts.jobs > 1 && _winter.history.capacity != 0;
 
-    if (ret == 0) {
-        return true;
-    }
-    if (ret == FNM_NOMATCH) {
-        return false;
+    for (size_t i = 0; i < suite->tests.length; ++i) {
+        const winter_unit_t unit = { .suite = suite, .test = _winter_array_get(&suite->tests, i) };
+        order[i] = (winter_weight_t){ .key = i, .weight = 0 };
+
+        // the top bit puts failed units before all others, the rest sorts by duration
+        if (by_duration) {
+            const uint64_t estimate = _winter_history_estimate(_winter_history_find(_winter_unit_hash(&unit)));
+            order[i].weight = estimate != 0 && estimate < INT64_MAX ? estimate : INT64_MAX;
+        }
+        if (_winter.opts.failed_first && _winter_is_unit_failed(&unit)) {
+            order[i].weight |= 1ULL << 63;
+        }
     }
 
-    _winter_fatal_error("Failed to match pattern: %s", pattern);
+    qsort(order, suite->tests.length, sizeof(winter_weight_t), _winter_weight_compare);
+    return order;
 }
 
-WINTER_FUNC winter_unit_t
-_winter_find_test(const char* pattern) {
+/// Order in which the suites run, with --failed-first the suites that contain a failed unit run before all others.
+WINTER_FUNC winter_weight_t*
+_winter_suites_order(void) {
+    winter_weight_t* order = malloc((_winter.suites.length + 1) * sizeof(winter_weight_t));
+    if (order == nullptr) {
+        _winter_fatal_error("Order allocation failed (suites: %zu)", _winter.suites.length);
+    }
+
     for (size_t i = 0; i < _winter.suites.length; ++i) {
         const winter_suite_t* suite = _winter_array_get(&_winter.suites, i);
-        if (!_winter_pattern_match_suite(pattern, suite->name)) {
-            continue;
-        }
+        order[i] = (winter_weight_t){ .key = i, .weight = 0 };
 
-        for (size_t j = 0; j < suite->tests.length; ++j) {
-            const winter_test_t* test = _winter_array_get(&suite->tests, j);
-            if (!_winter_pattern_match_test(pattern, test->name)) {
-                continue;
+        for (size_t j = 0; _winter.opts.failed_first && j < suite->tests.length; ++j) {
+            const winter_unit_t unit = { .suite = suite, .test = _winter_array_get(&suite->tests, j) };
+            if (_winter_is_unit_enabled(&unit) && _winter_is_unit_failed(&unit)) {
+                order[i].weight = 1;
+                break;
             }
-
-            return (winter_unit_t){
-                .start_time = _winter_now(),
-                .suite = suite,
-                .test = test,
-            };
         }
     }
 
-    _winter_fatal_error("No test found for pattern: %s", pattern);
+    qsort(order, _winter.suites.length, sizeof(winter_weight_t), _winter_weight_compare);
+    return order;
 }
 
+// ### BATCHES ########################################################################################################
+
+/// Usage between two readings of the usage of the same process, the resident set size is the one of the later reading.
 WINTER_FUNC void
-_winter_list(void) {
-    _winter_print(WINTER_COLOR_BOLD "\nTest suites:\n" WINTER_COLOR_RESET);
+_winter_rusage_delta(struct rusage* out, const struct rusage* after, const struct rusage* before) {
+    struct rusage usage = *after;
+    timersub(&after->ru_utime, &before->ru_utime, &usage.ru_utime);
+    timersub(&after->ru_stime, &before->ru_stime, &usage.ru_stime);
+    usage.ru_minflt -= before->ru_minflt;
+    usage.ru_majflt -= before->ru_majflt;
+    usage.ru_nvcsw -= before->ru_nvcsw;
+    usage.ru_nivcsw -= before->ru_nivcsw;
+    *out = usage;
+}
 
-    size_t total_tests = 0;
-    for (size_t i = 0; i < _winter.suites.length; ++i) {
-        const winter_suite_t* suite = _winter_array_get(&_winter.suites, i);
-        _winter_print(WINTER_COLOR_DESC "%s:" WINTER_COLOR_RESET " %ji tests\n", suite->name, suite->tests.length);
-        total_tests += suite->tests.length;
+/// Adds an enabled unit to the batch of the job. Returns the number of units in the batch.
+WINTER_FUNC uint32_t
+_winter_batch_add(winter_job_t* job, const winter_unit_t* unit) {
+    if (job->batch == nullptr) {
+        job->batch = calloc(1, sizeof(winter_batch_t));
+        if (job->batch == nullptr) {
+            _winter_fatal_error("Batch allocation failed");
+        }
     }
 
-    _winter_print(WINTER_COLOR_BOLD "\nTotal: %ji tests.\n" WINTER_COLOR_RESET, total_tests);
+    job->batch->units[job->batch->count] = *unit;
+    return ++job->batch->count;
 }
 
+/// Forks the process running the units of the batch from its first one. The units write into one file and record
+/// where their output ends, so the runner can hand every unit its part.
 WINTER_FUNC void
-_winter_debug(const char* pattern) {
-    winter_unit_t unit = _winter_find_test(pattern);
+_winter_batch_spawn(winter_job_t* job) {
+    winter_batch_t* batch = job->batch;
+    if (batch->shared == nullptr) {
+        batch->shared = _winter_shared_map(sizeof(winter_batch_shared_t));
+        for (uint32_t i = 0; i < batch->count; ++i) {
+            batch->units[i].output = _winter_output_create();
+            _winter_unit_map(&batch->units[i]);
+        }
+    }
 
-    while (true) {
-        _winter_print_unit_debug(&unit);
-        if (_winter_unit_debug(&unit)) {
-            break;
+    batch->output = tmpfile();
+    if (batch->output == nullptr) {
+        _winter_fatal_error("Failed to create a file for batch output (%s)", strerror(errno));
+    }
+
+    winter_batch_shared_t* shared = batch->shared;
+    atomic_store(&shared->started, batch->first);
+    atomic_store(&shared->finished, batch->first);
+
+    job->unit = (winter_unit_t){
+        .suite = batch->units[batch->first].suite,
+        .test = batch->units[batch->first].test,
+        .timeout = batch->units[batch->first].timeout,
+        .start_time = _winter_now(),
+    };
+
+    // anything still buffered would otherwise be written a second time by the child
+    fflush(nullptr);
+
+    job->pid = fork();
+    if (job->pid == 0) {
+        dup2(fileno(batch->output), STDOUT_FILENO);
+        dup2(fileno(batch->output), STDERR_FILENO);
+        setvbuf(stdout, nullptr, _IONBF, 0);
+        setvbuf(stderr, nullptr, _IONBF, 0);
+        _winter.print.file = stderr;
+
+        for (uint32_t i = batch->first; i < batch->count; ++i) {
+            winter_batch_result_t* result = &shared->results[i];
+            struct rusage before;
+            getrusage(RUSAGE_SELF, &before);
+            result->usage = before;
+            result->start_time = _winter_now();
+            atomic_store(&shared->started, i + 1);
+
+            _winter_process_entry(&batch->units[i]);
+
+            struct rusage after;
+            getrusage(RUSAGE_SELF, &after);
+            _winter_rusage_delta(&result->usage, &after, &before);
+            result->end_time = _winter_now();
+            result->output_end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+            atomic_store(&shared->finished, i + 1);
         }
+
+        _exit(0);
+    }
+
+    job->fd = -1;
+    if (job->pid > 0) {
+        _winter_wait_watch(job);
+    } else {
+        winter_unit_t* unit = &batch->units[batch->first];
+        _winter_unit_print(unit, WINTER_INDENT "Failed to fork process (%s).\n", strerror(errno));
     }
 }
 
-#define _winter_print_usage(path, u, d) fprintf(stdout, "  %s %-21s %s.\n", path, u, d);
+/// Starts the next enabled unit of the suite in the free job slot. Returns false if there are no units left. The
+/// before_all fixture of the suite runs in this process right before the first unit is forked, so every test process
+/// inherits it without running it again.
+/// With --batch the job starts a process for the next enabled units instead, up to WINTER_BATCH_SIZE and few enough
+/// that the units left are spread over all jobs.
+WINTER_FUNC bool
+_winter_job_start(
+  winter_job_t* job,
+  const winter_suite_t* suite,
+  const winter_weight_t* order,
+  size_t* next,
+  bool* prepared
+) {
+    const size_t share = (suite->tests.length - *next + _winter.opts.jobs - 1) / _winter.opts.jobs;
+    const uint32_t batch_size = share < WINTER_BATCH_SIZE ? (uint32_t)share : WINTER_BATCH_SIZE;
 
-#define _winter_print_opt_flag(n, sn, expl, d)                                                                         \
-    fprintf(stdout, "  %-20s%s.\n", "--[no-]" n " | -" sn, expl);                                                      \
-    fprintf(stdout, "  %-20sDefault: %s.\n", "", d)
+    while (*next < suite->tests.length) {
+        const winter_test_t* test = _winter_array_get(&suite->tests, order[(*next)++].key);
+        job->unit = (winter_unit_t){
+            .suite = suite,
+            .test = test,
+        };
+
+        if (!_winter_is_unit_enabled(&job->unit)) {
+            continue;
+        }
+        job->unit.timeout = _winter_unit_timeout(&job->unit);
+
+        if (!*prepared) {
+            suite->func(WINTER_FUNC_BEFORE_ALL);
+            *prepared = true;
+        }
+
+        if (_winter.opts.batch) {
+            if (_winter_batch_add(job, &job->unit) < batch_size) {
+                continue;
+            }
+            break;
+        }
+
+        job->unit.start_time = _winter_now();
+
+        _winter_print_unit_begin(&job->unit);
+        job->pid = _winter_unit_spawn(&job->unit);
+        job->fd = -1;
+
+        if (job->pid > 0) {
+            _winter_wait_watch(job);
+        }
+
+        return true;
+    }
 
-#define _winter_print_opt_str(n, expl, d)                                                                              \
-    fprintf(stdout, "  %-20s%s.\n", "--" n " value", expl);                                                            \
-    fprintf(stdout, "  %-20sDefault: %s.\n", "", d)
+    if (job->batch != nullptr) {
+        _winter_batch_spawn(job);
+        return true;
+    }
+
+    return false;
+}
 
+/// Tells how many iterations a repeated unit passed, or the iteration that failed and the seed it ran with.
 WINTER_FUNC void
-_winter_print_help(const char* path) {
-    fprintf(stdout, "Usages:\n");
-    _winter_print_usage(path, "[options] [patterns]", "Run all tests that match the patterns");
-    _winter_print_usage(path, "--help | -h", "Print this help text and exit");
-    _winter_print_usage(path, "--version | -v", "Print version and exit");
-    _winter_print_usage(path, "--list | -l", "Print a list of all available tests");
-    _winter_print_usage(path, "--debug pattern", "Run one test and wait for a debugger to attach to the test");
+_winter_repeat_report(const winter_unit_t* unit, const bool success) {
+    if (unit->repeat == nullptr || atomic_load(&unit->repeat->iteration) == 0) {
+        return;
+    }
 
-    fprintf(stdout, "\nOptions:\n");
-    _winter_print_opt_flag("color", "c", "Whether to print output in color", "on when output is TTY");
-    _winter_print_opt_flag("rerun", "r", "Rerun failed test and wait for a debugger to attach to the test", "off");
-    _winter_print_opt_flag("pid", "p", "Print the pid of the test process", "off");
-    _winter_print_opt_flag("timeout", "t", "Whether to fail a test after its timeout.", "on");
+    const uint64_t iteration = atomic_load(&unit->repeat->iteration);
+    if (success) {
+        _winter_unit_print(unit, WINTER_INDENT "Passed %ju iterations.\n", (uintmax_t)iteration);
+    } else {
+        _winter_unit_print(
+          unit,
+          WINTER_INDENT "Failed in iteration %ju. Reproduce with --seed 0x%016jx\n",
+          (uintmax_t)iteration,
+          (uintmax_t)atomic_load(&unit->repeat->seed)
+        );
+    }
 }
 
-#define _winter_opt_flag(opt, n, sn)                                                                                   \
-    opt.name = n;                                                                                                      \
-    opt.short_name = sn;                                                                                               \
-    opt.is_flag = true;                                                                                                \
-    opt.bool_val = false;                                                                                              \
-    opt.overwritten = false
+/// Reports the result of a finished unit and releases its output and shared memory.
+WINTER_FUNC void
+_winter_unit_finish(winter_unit_t* unit, bool success, uint32_t* test_count, uint32_t* success_count) {
+    success = _winter_baseline_check(unit) && success;
+    _winter_repeat_report(unit, success);
 
-#define _winter_opt_str(opt, n)                                                                                        \
-    opt.name = n;                                                                                                      \
-    opt.short_name = '\0';                                                                                             \
-    opt.is_flag = false;                                                                                               \
-    opt.str_val = nullptr;                                                                                             \
-    opt.overwritten = false
+    while (!success && _winter.opts.rerun) {
+        if (_winter_unit_debug(unit)) {
+            break;
+        }
+    }
 
-#define _winter_opt_default(opt, val)                                                                                  \
-    if (!opt.overwritten)                                                                                              \
-    opt.bool_val = val
+    _winter_print_unit_end(unit, success);
+    _winter_history_record(unit, success);
+
+    _winter_output_close(unit->output);
+    unit->output = nullptr;
+    _winter_unit_unmap(unit);
 
+    *test_count += 1;
+    *success_count += success ? 1 : 0;
+}
+
+/// Reports the result of a finished job and frees its slot.
 WINTER_FUNC void
-_winter_parse_args(const int argc, const char** argv) {
-    _winter_opt_t opts[_WINTER_OPT_LAST];
+_winter_job_finish(winter_job_t* job, const bool success, uint32_t* test_count, uint32_t* success_count) {
+    _winter_unit_finish(&job->unit, success, test_count, success_count);
+    _winter_wait_release(job);
+    job->pid = 0;
+}
 
-    _winter_opt_flag(opts[_WINTER_OPT_VERSION], "version", 'v');
-    _winter_opt_flag(opts[_WINTER_OPT_HELP], "help", 'h');
-    _winter_opt_flag(opts[_WINTER_OPT_LIST], "list", 'l');
-    _winter_opt_flag(opts[_WINTER_OPT_COLOR], "color", 'c');
-    _winter_opt_flag(opts[_WINTER_OPT_RERUN], "rerun", 'r');
-    _winter_opt_flag(opts[_WINTER_OPT_TIMEOUT], "timeout", 't');
+/// Forks the replay of the next candidate of the crashed case as the process of the job, or the replay of the shrunk
+/// case with its values printed once no candidate is left.
+WINTER_FUNC void
+_winter_crash_replay(winter_job_t* job) {
+    const winter_unit_t* unit = job->crashed;
+    winter_property_t* property = unit->property;
+    winter_shrink_t* shrink = &property->shrink;
+
+    const bool verbose = !_winter_shrink_next(shrink, property->choices, &property->length);
+    if (verbose) {
+        property->length = shrink->length;
+        memcpy(property->choices, shrink->choices, shrink->length * sizeof(uint64_t));
+    }
+
+    job->pid = _winter_property_replay(unit, verbose);
+    job->fd = -1;
+    if (job->pid > 0) {
+        _winter_wait_watch(job);
+    }
+}
+
+/// Starts shrinking the case of a property that crashed the test process of the unit. Its choices are replayed by the
+/// job in new processes, polled like any other job so the other jobs keep running meanwhile, and a candidate fails if
+/// its process is terminated by the same signal. Returns false if the unit can be reported right away.
+WINTER_FUNC bool
+_winter_crash_start(winter_job_t* job, winter_unit_t* unit) {
+    if (!_winter_property_crashed(unit)) {
+        return false;
+    }
 
-    _winter_opt_str(opts[_WINTER_OPT_DEBUG], "debug");
+    winter_property_t* property = unit->property;
+    _winter_shrink_init(&property->shrink, property->choices, property->overflow ? 0 : property->index);
+    if (property->overflow) {
+        _winter_property_crash_report(unit);
+        return false;
+    }
 
-    for (int i = 1; i < argc; ++i) {
-        const char* arg = argv[i];
+    _winter_wait_release(job);
+    job->crashed = unit;
+    _winter_crash_replay(job);
+    return true;
+}
 
-        if (arg[0] != '-') {
-            _winter_array_push(&_winter.patterns, &arg);
-            continue;
+/// Checks on the replay of the job without blocking and starts the next one once it ended. Returns true when the
+/// crashed case has been shrunk and replayed with its values printed.
+WINTER_FUNC bool
+_winter_crash_poll(winter_job_t* job) {
+    const winter_unit_t* unit = job->crashed;
+    winter_property_t* property = unit->property;
+    _winter_output_drain(unit->output);
+
+    int status = 0;
+    if (job->pid > 0) {
+        const pid_t ret = waitpid(job->pid, &status, WNOHANG);
+        if (ret == 0 || (ret == -1 && errno == EINTR)) {
+            return false;
         }
+    }
 
-        const bool is_long = arg[1] == '-';
-        const char* name = is_long ? arg + 2 : arg + 1;
-        const bool inverted = is_long && strncmp(name, "no-", 3) == 0;
+    _winter_wait_release(job);
+    _winter_output_drain(unit->output);
 
-        if (inverted) {
-            name += 3;
-        }
+    if (!property->verbose) {
+        const int signal = job->pid > 0 && WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+        _winter_shrink_result(
+          &property->shrink, signal == unit->signal && !property->overflow, property->choices, property->index
+        );
+        _winter_crash_replay(job);
+        return false;
+    }
 
-        bool valid = false;
-        for (uint32_t j = 0; j < _WINTER_OPT_LAST; ++j) {
-            _winter_opt_t* opt = &opts[j];
+    _winter_property_crash_report(unit);
+    return true;
+}
 
-            if (is_long) {
-                valid = strcmp(opt->name, name) == 0;
-            } else {
-                valid = opt->short_name == name[0];
-            }
-            if (!valid) {
-                continue;
-            }
+/// Forks a new process for the units of the batch that have not been reported. Returns true once every unit of the
+/// batch has been reported and the batch is released.
+WINTER_FUNC bool
+_winter_batch_resume(winter_job_t* job) {
+    winter_batch_t* batch = job->batch;
+    if (batch->reported < batch->count) {
+        batch->first = batch->reported;
+        _winter_batch_spawn(job);
+        return false;
+    }
 
-            opt->overwritten = true;
+    _winter_shared_unmap(batch->shared, sizeof(winter_batch_shared_t));
+    free(batch);
+    job->batch = nullptr;
+    return true;
+}
 
-            if (opt->is_flag) {
-                opt->bool_val = !inverted;
-            } else {
-                if (++i >= argc) {
-                    _winter_fatal_error("Option %s requires an argument", arg);
-                }
+/// Reports the unit whose crashed case has been shrunk. Returns true once the job is done, a batch goes on with the
+/// units after it.
+WINTER_FUNC bool
+_winter_crash_finish(winter_job_t* job, uint32_t* test_count, uint32_t* success_count) {
+    winter_unit_t* unit = job->crashed;
+    job->crashed = nullptr;
+    job->pid = 0;
 
-                opt->str_val = argv[i];
-            }
+    if (job->batch == nullptr) {
+        _winter_job_finish(job, false, test_count, success_count);
+        return true;
+    }
+
+    _winter_unit_finish(unit, false, test_count, success_count);
+    return _winter_batch_resume(job);
+}
 
+/// Hands a unit of the batch the part of the output file from start to end, or to the end of the file if end is
+/// negative.
+WINTER_FUNC void
+_winter_batch_output(const winter_batch_t* batch, winter_unit_t* unit, off_t start, off_t end) {
+    const int fd = fileno(batch->output);
+    if (end < 0) {
+        struct stat stat;
+        end = fstat(fd, &stat) == 0 ? stat.st_size : start;
+    }
+
+    char buffer[16384];
+    while (start < end) {
+        const size_t size = (size_t)(end - start) < sizeof(buffer) ? (size_t)(end - start) : sizeof(buffer);
+        const ssize_t length = pread(fd, buffer, size, start);
+        if (length <= 0) {
+            if (length == -1 && errno == EINTR) {
+                continue;
+            }
             break;
         }
 
-        if (!valid) {
-            _winter_fatal_error("Unknown option: %s", arg);
-        }
+        _winter_output_append(unit->output, buffer, (size_t)length);
+        start += length;
     }
+}
 
-    if (opts[_WINTER_OPT_HELP].bool_val) {
-        _winter_print_help(argv[0]);
-        _exit(EXIT_SUCCESS);
-    }
-    if (opts[_WINTER_OPT_VERSION].bool_val) {
-        fprintf(stdout, "Winter %s\n", WINTER_VERSION);
-        _exit(EXIT_SUCCESS);
+/// Offset in the output file at which the output of the unit at the index starts.
+WINTER_FUNC off_t
+_winter_batch_output_start(const winter_batch_t* batch, const uint32_t index) {
+    return index == batch->first ? 0 : batch->shared->results[index - 1].output_end;
+}
+
+/// Reports the units the batch process passed since the last call. The job then tracks the running unit, so its
+/// timeout is waited for like the one of a single unit.
+WINTER_FUNC void
+_winter_batch_report(winter_job_t* job, uint32_t* test_count, uint32_t* success_count) {
+    winter_batch_t* batch = job->batch;
+    const winter_batch_shared_t* shared = batch->shared;
+
+    const uint32_t finished = atomic_load(&shared->finished);
+    while (batch->reported < finished) {
+        winter_unit_t* unit = &batch->units[batch->reported];
+        const winter_batch_result_t* result = &shared->results[batch->reported];
+
+        unit->start_time = result->start_time;
+        unit->end_time = result->end_time;
+        unit->usage = result->usage;
+        _winter_batch_output(batch, unit, _winter_batch_output_start(batch, batch->reported), result->output_end);
+
+        batch->reported += 1;
+        _winter_unit_finish(unit, _winter_unit_budget(unit), test_count, success_count);
     }
-    if (opts[_WINTER_OPT_LIST].bool_val) {
-        _winter_list();
-        _exit(EXIT_SUCCESS);
+
+    if (batch->reported < batch->count && atomic_load(&shared->started) > batch->reported) {
+        job->unit.test = batch->units[batch->reported].test;
+        job->unit.timeout = batch->units[batch->reported].timeout;
+        job->unit.start_time = shared->results[batch->reported].start_time;
     }
-    if (opts[_WINTER_OPT_DEBUG].str_val != nullptr) {
-        _winter_debug(opts[_WINTER_OPT_DEBUG].str_val);
-        _exit(EXIT_SUCCESS);
+}
+
+/// Checks on the process of a batch without blocking. When the process died or timed out, the running unit fails and
+/// a new process is forked for the units after it. Returns true once every unit of the batch has been reported.
+WINTER_FUNC bool
+_winter_batch_poll(winter_job_t* job, uint32_t* test_count, uint32_t* success_count) {
+    winter_batch_t* batch = job->batch;
+
+    int status = 0;
+    struct rusage usage = { 0 };
+    pid_t ret = job->pid;
+    int error = 0;
+    if (job->pid > 0) {
+        ret = wait4(job->pid, &status, WNOHANG, &usage);
+        error = errno;
     }
 
-    const bool is_tty = isatty(fileno(_winter.print.file));
-    const bool no_color = getenv("NO_COLOR") != nullptr;
-    _winter_opt_default(opts[_WINTER_OPT_COLOR], is_tty && !no_color);
-    _winter_opt_default(opts[_WINTER_OPT_TIMEOUT], true);
+    _winter_batch_report(job, test_count, success_count);
 
-    _winter.opts.list = opts[_WINTER_OPT_LIST].bool_val;
-    _winter.opts.color = opts[_WINTER_OPT_COLOR].bool_val;
-    _winter.opts.rerun = opts[_WINTER_OPT_RERUN].bool_val;
-    _winter.opts.timeout = opts[_WINTER_OPT_TIMEOUT].bool_val;
-}
+    bool timed_out = false;
+    if (ret == 0 || (ret == -1 && error == EINTR)) {
+        if (!_winter.opts.timeout || _winter_unit_elapsed_ms(&job->unit) <= job->unit.timeout) {
+            return false;
+        }
 
-WINTER_FUNC bool
-_winter_is_suite_enabled(const winter_suite_t* suite) {
-    if (_winter.patterns.length == 0) {
-        return true;
+        // a unit may have passed right before the process was killed
+        _winter_kill_process(job->pid, &usage);
+        _winter_batch_report(job, test_count, success_count);
+        timed_out = true;
     }
 
-    for (size_t i = 0; i < _winter.patterns.length; ++i) {
-        const char** pattern = _winter_array_get(&_winter.patterns, i);
-        if (_winter_pattern_match_suite(*pattern, suite->name)) {
-            return true;
+    winter_unit_t* unit = nullptr;
+    bool success = false;
+    if (batch->reported < batch->count) {
+        unit = &batch->units[batch->reported];
+        const winter_batch_result_t* result = &batch->shared->results[batch->reported];
+        const bool started = atomic_load(&batch->shared->started) > batch->reported;
+
+        unit->start_time = started ? result->start_time : job->unit.start_time;
+        unit->end_time = _winter_now();
+        if (started) {
+            _winter_rusage_delta(&unit->usage, &usage, &result->usage);
+        } else {
+            unit->usage = usage;
         }
+        _winter_batch_output(batch, unit, _winter_batch_output_start(batch, batch->reported), -1);
+
+        if (job->pid == -1) {
+            // the reason has been printed when forking failed
+        } else if (timed_out) {
+            unit->timed_out = true;
+            unit->signal = SIGKILL;
+            _winter_unit_print_timeout(unit);
+        } else if (ret == -1) {
+            _winter_unit_print(unit, WINTER_INDENT "Waiting for process failed (%s).\n", strerror(error));
+        } else {
+            success = _winter_unit_status(unit, status) && _winter_unit_budget(unit);
+        }
+
+        batch->reported += 1;
     }
 
-    return false;
-}
+    fclose(batch->output);
+    batch->output = nullptr;
+    _winter_wait_release(job);
+    job->pid = 0;
 
-WINTER_FUNC bool
-_winter_is_unit_enabled(const winter_unit_t* unit) {
-    if (_winter.patterns.length == 0) {
-        return true;
+    if (unit != nullptr) {
+        if (_winter_crash_start(job, unit)) {
+            return false;
+        }
+        _winter_unit_finish(unit, success, test_count, success_count);
     }
 
-    const char* suite_name = unit->suite->name;
-    const char* test_name = unit->test->name;
+    return _winter_batch_resume(job);
+}
 
-    for (size_t i = 0; i < _winter.patterns.length; ++i) {
-        const char** pattern = _winter_array_get(&_winter.patterns, i);
+/// Runs all enabled units of a suite, keeping up to opts.jobs processes running at the same time. Units of different
+/// suites never overlap, so every suite summary is printed after all of its units have finished.
+WINTER_FUNC void
+_winter_suite_execute(const winter_suite_t* suite, winter_job_t* jobs, uint32_t* test_count, uint32_t* success_count) {
+    winter_weight_t* order = _winter_suite_order(suite);
+    size_t next = 0;
+    uint32_t running = 0;
+    bool prepared = false;
 
-        if (!_winter_pattern_match_suite(*pattern, suite_name)) {
-            continue;
+    while (true) {
+        for (uint32_t i = 0; i < _winter.opts.jobs && next < suite->tests.length; ++i) {
+            if (jobs[i].pid != 0 || !_winter_job_start(&jobs[i], suite, order, &next, &prepared)) {
+                continue;
+            }
+
+            if (jobs[i].pid == -1 && jobs[i].batch == nullptr) {
+                jobs[i].unit.end_time = _winter_now();
+                _winter_job_finish(&jobs[i], false, test_count, success_count);
+            } else {
+                running += 1;
+            }
         }
-        if (_winter_pattern_match_test(*pattern, test_name)) {
-            return true;
+
+        if (running == 0) {
+            break;
+        }
+
+        bool finished = false;
+        for (uint32_t i = 0; i < _winter.opts.jobs; ++i) {
+            if (jobs[i].crashed != nullptr) {
+                if (_winter_crash_poll(&jobs[i]) && _winter_crash_finish(&jobs[i], test_count, success_count)) {
+                    running -= 1;
+                    finished = true;
+                }
+                continue;
+            }
+
+            if (jobs[i].batch != nullptr) {
+                if (_winter_batch_poll(&jobs[i], test_count, success_count)) {
+                    running -= 1;
+                    finished = true;
+                }
+                continue;
+            }
+
+            bool success = false;
+            if (jobs[i].pid == 0 || !_winter_job_poll(&jobs[i], &success)) {
+                continue;
+            }
+            if (!success && _winter_crash_start(&jobs[i], &jobs[i].unit)) {
+                continue;
+            }
+
+            _winter_job_finish(&jobs[i], success, test_count, success_count);
+            running -= 1;
+            finished = true;
+        }
+
+        if (!finished) {
+            _winter_wait(jobs, _winter.opts.jobs, _winter_wait_timeout(jobs, _winter.opts.jobs));
         }
     }
 
-    return false;
+    if (prepared) {
+        suite->func(WINTER_FUNC_AFTER_ALL);
+    }
+
+    free(order);
 }
 
 WINTER_FUNC int
@@ -764,12 +4974,25 @@ _winter_main(const int argc, const char** argv) {
     _winter_initialize();
     _winter_parse_args(argc, argv);
 
-    const double start_time = _winter_now();
+    if (_winter.opts.weighted && _winter.opts.shard_count > 1) {
+        _winter_shard_balance();
+    }
+
+    winter_job_t* jobs = calloc(_winter.opts.jobs, sizeof(winter_job_t));
+    if (jobs == nullptr) {
+        _winter_fatal_error("Job allocation failed (jobs: %u)", _winter.opts.jobs);
+    }
+
+    const uint64_t start_time = _winter_now();
     uint32_t global_test_count = 0;
     uint32_t global_success_count = 0;
 
+    _winter_print_header();
+
+    winter_weight_t* order = _winter_suites_order();
+
     for (size_t i = 0; i < _winter.suites.length; ++i) {
-        const winter_suite_t* suite = _winter_array_get(&_winter.suites, i);
+        const winter_suite_t* suite = _winter_array_get(&_winter.suites, order[i].key);
         if (!_winter_is_suite_enabled(suite)) {
             continue;
         }
@@ -778,33 +5001,7 @@ _winter_main(const int argc, const char** argv) {
 
         uint32_t suite_test_count = 0;
         uint32_t suite_success_count = 0;
-        for (size_t k = 0; k < suite->tests.length; ++k) {
-            winter_unit_t unit = {
-                .start_time = _winter_now(),
-                .suite = suite,
-                .test = _winter_array_get(&suite->tests, k),
-            };
-
-            if (!_winter_is_unit_enabled(&unit)) {
-                continue;
-            }
-
-            _winter_print_unit_begin(&unit);
-            const bool success = _winter_unit_execute(&unit);
-
-            while (!success && _winter.opts.rerun) {
-                _winter_print_unit_debug(&unit);
-
-                if (_winter_unit_debug(&unit)) {
-                    break;
-                }
-            }
-
-            _winter_print_unit_end(&unit, success);
-
-            suite_test_count += 1;
-            suite_success_count += success ? 1 : 0;
-        }
+        _winter_suite_execute(suite, jobs, &suite_test_count, &suite_success_count);
 
         _winter_print_suite_end(suite, suite_test_count, suite_success_count);
 
@@ -813,6 +5010,10 @@ _winter_main(const int argc, const char** argv) {
     }
 
     _winter_print_summary(start_time, global_success_count, global_test_count);
+    _winter_history_save();
+    _winter_baseline_save();
+    free(order);
+    free(jobs);
 
     if (global_test_count == global_success_count) {
         return EXIT_SUCCESS;
@@ -823,10 +5024,47 @@ _winter_main(const int argc, const char** argv) {
 
 #ifdef WINTER_TEST
 
+#if defined(WINTER_ALLOC_TRACKING) && defined(__linux__)
+// wrappers of the allocator for the objects linked with WINTER_ALLOC_LDFLAGS, calls from within libc are not counted
+#define _winter_alloc_wrappers()                                                                                       \
+    void* __real_malloc(size_t);                                                                                       \
+    void* __real_calloc(size_t, size_t);                                                                               \
+    void* __real_realloc(void*, size_t);                                                                               \
+    void __real_free(void*);                                                                                           \
+                                                                                                                       \
+    void* __wrap_malloc(const size_t size) {                                                                           \
+        void* ptr = __real_malloc(size);                                                                               \
+        _winter_alloc_record(ptr);                                                                                     \
+        return ptr;                                                                                                    \
+    }                                                                                                                  \
+                                                                                                                       \
+    void* __wrap_calloc(const size_t count, const size_t size) {                                                       \
+        void* ptr = __real_calloc(count, size);                                                                        \
+        _winter_alloc_record(ptr);                                                                                     \
+        return ptr;                                                                                                    \
+    }                                                                                                                  \
+                                                                                                                       \
+    void* __wrap_realloc(void* old, const size_t size) {                                                               \
+        _winter_free_record(old);                                                                                      \
+        void* ptr = __real_realloc(old, size);                                                                         \
+        _winter_alloc_record(ptr);                                                                                     \
+        return ptr;                                                                                                    \
+    }                                                                                                                  \
+                                                                                                                       \
+    void __wrap_free(void* ptr) {                                                                                      \
+        _winter_free_record(ptr);                                                                                      \
+        __real_free(ptr);                                                                                              \
+    }
+#else
+#define _winter_alloc_wrappers()
+#endif
+
 #define winter_main()                                                                                                  \
     winter_t _winter;                                                                                                  \
     _Thread_local winter_local_t _winter_local;                                                                        \
                                                                                                                        \
+    _winter_alloc_wrappers()                                                                                           \
+                                                                                                                       \
     int main(const int argc, const char** argv) {                                                                      \
         return _winter_main(argc, argv);                                                                               \
     }                                                                                                                  \
@@ -855,6 +5093,9 @@ _winter_main(const int argc, const char** argv) {
 #define _winter_fail_end()                                                                                             \
     do {                                                                                                               \
         _winter_print("    in %s:%i\n", _winter_local.filename, _winter_local.linenum);                                \
+        fflush(_winter.print.file);                                                                                    \
+        _winter_record_failure(_winter_local.filename, _winter_local.linenum);                                         \
+        _winter_property_fail();                                                                                       \
         _exit(WINTER_EXIT_FAILURE);                                                                                    \
     } while (0)
 
@@ -1018,59 +5259,341 @@ _winter_assert_str(
         }                                                                                                              \
     } while (0)
 
+WINTER_FUNC void
+_winter_allocs_require(void) {
+    const winter_allocs_t* counters = atomic_load(&_winter.alloc.counters);
+    if (counters == nullptr || !counters->available) {
+        _winter_fail(
+          "(allocs) Allocations are not tracked, define WINTER_ALLOC_TRACKING and link with %s (make %s)",
+          "WINTER_ALLOC_LDFLAGS",
+          "ALLOC_TRACKING=1"
+        );
+    }
+}
+
+WINTER_FUNC uint64_t
+_winter_allocs_count(void) {
+    _winter_allocs_require();
+    return atomic_load(&atomic_load(&_winter.alloc.counters)->allocs);
+}
+
+/// Fails if the block allocates more than n times. Allocations of all threads of the test are counted.
+#define assert_max_allocs(n, ...)                                                                                      \
+    do {                                                                                                               \
+        _winter_fail_update();                                                                                         \
+        const uint64_t _winter_allocs_before = _winter_allocs_count();                                                 \
+        __VA_ARGS__;                                                                                                   \
+        const uint64_t _winter_allocs = _winter_allocs_count() - _winter_allocs_before;                                \
+        if (_winter_allocs > (uint64_t)(n)) {                                                                          \
+            _winter_fail("(allocs) Expected at most %ju allocations, but got %ju", (uintmax_t)(n), _winter_allocs);    \
+        }                                                                                                              \
+    } while (0)
+
+/// Fails if blocks allocated since the test body started have not been freed.
+#define assert_no_leaks(...)                                                                                           \
+    do {                                                                                                               \
+        _winter_fail_update();                                                                                         \
+        _winter_allocs_require();                                                                                      \
+        const winter_allocs_t* _winter_counters = atomic_load(&_winter.alloc.counters);                                \
+        const uint64_t _winter_allocs = atomic_load(&_winter_counters->allocs);                                        \
+        const uint64_t _winter_frees = atomic_load(&_winter_counters->frees);                                          \
+        if (_winter_allocs > _winter_frees) {                                                                          \
+            _winter_fail_expl(                                                                                         \
+              "" __VA_ARGS__,                                                                                          \
+              "(allocs) Expected no leaks, but %ju of %ju allocations were not freed",                                 \
+              (uintmax_t)(_winter_allocs - _winter_frees),                                                             \
+              (uintmax_t)_winter_allocs                                                                                \
+            );                                                                                                         \
+        }                                                                                                              \
+    } while (0)
+
+// ### BENCHMARKS #####################################################################################################
+
+typedef enum {
+    _WINTER_BENCH_CALIBRATE,
+    _WINTER_BENCH_WARMUP,
+    _WINTER_BENCH_SAMPLE,
+} winter_bench_phase_t;
+
+typedef struct {
+    winter_bench_phase_t phase;
+    bool running;
+
+    uint64_t iterations;
+    uint64_t start_time;
+    uint64_t phase_time;
+
+    uint32_t sample_count;
+    double samples[WINTER_BENCH_SAMPLES];
+
+    // readings of the hardware counters when sampling started
+    winter_counter_read_t counters[WINTER_COUNTER_LAST];
+} winter_bench_t;
+
+WINTER_FUNC int
+_winter_bench_compare(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+WINTER_FUNC void
+_winter_bench_report(winter_bench_t* bench) {
+    const uint32_t n = bench->sample_count;
+    qsort(bench->samples, n, sizeof(double), _winter_bench_compare);
+
+    double sum = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        sum += bench->samples[i];
+    }
+    const double mean = sum / n;
+
+    double variance = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        variance += (bench->samples[i] - mean) * (bench->samples[i] - mean);
+    }
+    variance /= n > 1 ? n - 1 : 1;
+
+    const double median = n % 2 ? bench->samples[n / 2] : (bench->samples[n / 2 - 1] + bench->samples[n / 2]) / 2;
+    const double p99 = bench->samples[(uint32_t)ceil(0.99 * n) - 1];
+
+    _winter_print(WINTER_INDENT "min ");
+    _winter_print_ns(bench->samples[0]);
+    _winter_print(", median ");
+    _winter_print_ns(median);
+    _winter_print(", mean ");
+    _winter_print_ns(mean);
+    _winter_print(", p99 ");
+    _winter_print_ns(p99);
+    _winter_print(", stddev ");
+    _winter_print_ns(sqrt(variance));
+    _winter_print(" (%u samples of %ju iterations)\n", n, (uintmax_t)bench->iterations);
+
+    if (_winter_local.unit != nullptr && _winter_local.unit->counters != nullptr) {
+        winter_counter_read_t end[WINTER_COUNTER_LAST];
+        _winter_counters_read(end);
+
+        winter_counters_t counters;
+        _winter_counters_delta(&counters, bench->counters, end);
+
+        bool available = false;
+        for (int i = 0; i < WINTER_COUNTER_LAST; ++i) {
+            available |= counters.available[i];
+        }
+        if (available) {
+            _winter_print(WINTER_INDENT);
+            _winter_print_counters(&counters, (double)n * (double)bench->iterations);
+            _winter_print(" per iteration\n");
+        }
+    }
+
+    // the runner compares the result with the baseline after the process exited
+    if (_winter_local.unit != nullptr && _winter_local.unit->bench != nullptr) {
+        *_winter_local.unit->bench = (winter_bench_stats_t){
+            .count = n,
+            .mean = mean,
+            .variance = variance,
+            .median = median,
+        };
+    }
+}
+
+/// Drives the loop of a bench block, called before every sample. First doubles the iteration count until one sample
+/// takes WINTER_BENCH_SAMPLE_NS, then warms up for WINTER_BENCH_WARMUP_NS and finally records the time per iteration
+/// of up to WINTER_BENCH_SAMPLES samples.
+WINTER_FUNC bool
+_winter_bench_next(winter_bench_t* bench) {
+    const uint64_t now = _winter_now();
+
+    if (!bench->running) {
+        bench->running = true;
+        bench->phase_time = now;
+        bench->start_time = _winter_now();
+        return true;
+    }
+
+    const uint64_t elapsed = now - bench->start_time;
+
+    switch (bench->phase) {
+    case _WINTER_BENCH_CALIBRATE:
+        if (elapsed < WINTER_BENCH_SAMPLE_NS && bench->iterations < (UINT64_MAX >> 1)) {
+            bench->iterations *= 2;
+        } else {
+            bench->phase = _WINTER_BENCH_WARMUP;
+            bench->phase_time = now;
+        }
+        break;
+    case _WINTER_BENCH_WARMUP:
+        if (now - bench->phase_time >= WINTER_BENCH_WARMUP_NS) {
+            bench->phase = _WINTER_BENCH_SAMPLE;
+            bench->phase_time = now;
+            _winter_counters_read(bench->counters);
+        }
+        break;
+    case _WINTER_BENCH_SAMPLE: {
+        bench->samples[bench->sample_count++] = (double)elapsed / (double)bench->iterations;
+
+        const bool full = bench->sample_count == WINTER_BENCH_SAMPLES;
+        const bool exhausted = now - bench->phase_time >= WINTER_BENCH_BUDGET_NS;
+        if (full || (exhausted && bench->sample_count >= WINTER_BENCH_MIN_SAMPLES)) {
+            _winter_bench_report(bench);
+            return false;
+        }
+        break;
+    }
+    }
+
+    bench->start_time = _winter_now();
+    return true;
+}
+
+/// Forces the compiler to materialize the value, so that the computation of it can not be removed.
+#define do_not_optimize(value)                                                                                         \
+    do {                                                                                                               \
+        __typeof__(value) _winter_value = (value);                                                                     \
+        __asm__ volatile("" : : "r,m"(_winter_value) : "memory");                                                      \
+    } while (0)
+
+/// Forces the compiler to assume that all memory has been read and written.
+#define clobber() __asm__ volatile("" : : : "memory")
+
 // ### TEST CREATION ###################################################################################################
 
 #ifdef WINTER_TEST
 
-#define describe(name)                                                                                                 \
-    static void _winter_test_##name(uint64_t, winter_array_t*);                                                        \
-                                                                                                                       \
-    __attribute__((constructor(__COUNTER__ + 203))) static void _winter_constructor_pager(void) {                      \
-        _winter_initialize();                                                                                          \
-                                                                                                                       \
-        winter_array_t tests;                                                                                          \
-        _winter_array_init(&tests, sizeof(winter_test_t));                                                             \
-                                                                                                                       \
-        _winter_test_##name(WINTER_FUNC_INFO, &tests);                                                                 \
+// Suites and tests are registered by pointers to their descriptors in linker sections, so nothing runs before main.
+// Pointers are placed instead of the descriptors, the compiler may pad larger objects in a section.
+#if defined(__APPLE__)
+#define _winter_register(name, type, descriptor)                                                                       \
+    __attribute__((used, section("__DATA," #name))) static const type* const _WINTER_CONCAT(                         \
+      _winter_register_, __COUNTER__                                                                                   \
+    ) = &descriptor
+#else
+#define _winter_register(name, type, descriptor)                                                                       \
+    __attribute__((used, section(#name))) static const type* const _WINTER_CONCAT(_winter_register_, __COUNTER__) =    \
+      &descriptor
+#endif
+
+/// Declares a suite, its body holds the tests and fixtures. A test starts by jumping straight to its own body, so
+/// statements and declarations between the blocks of the suite do not run before it, and variables declared there are
+/// not initialized for it. Keep state of the suite in static variables and set it up in before_each() or before_all().
+#define describe(suite_name)                                                                                           \
+    static void _winter_test_##suite_name(uint64_t);                                                                   \
                                                                                                                        \
-        const winter_suite_t suite = { #name, tests, _winter_test_##name };                                            \
-        _winter_array_push(&_winter.suites, &suite);                                                                   \
-    }                                                                                                                  \
+    static const winter_suite_descriptor_t _winter_describe_##suite_name = {                                           \
+        .name = #suite_name,                                                                                           \
+        .function = "_winter_test_" #suite_name,                                                                       \
+        .file = __FILE__,                                                                                              \
+        .line = __LINE__,                                                                                              \
+        .func = _winter_test_##suite_name,                                                                             \
+    };                                                                                                                 \
+    _winter_register(winter_suites, winter_suite_descriptor_t, _winter_describe_##suite_name);                         \
                                                                                                                        \
-    __attribute__((optnone)) static void _winter_test_##name(                                                          \
-      const uint64_t index __attribute__((unused)), winter_array_t* out __attribute__((unused))                        \
-    )
+    WINTER_SUITE_FUNC void _winter_test_##suite_name(const uint64_t index __attribute__((unused)))
 
 #define TEST_ONLY
 
 #else
 
-#define describe(name)                                                                                                 \
-    WINTER_FUNC void _winter_unused_##name(                                                                            \
-      const uint64_t index __attribute__((unused)), winter_array_t* out __attribute__((unused))                        \
-    )
+// the descriptors are not registered, so they are removed together with the unused function
+#define _winter_register(name, type, descriptor)                                                                       \
+    __attribute__((unused)) static const type* const _WINTER_CONCAT(_winter_register_, __COUNTER__) = &descriptor
+
+#define describe(name) WINTER_FUNC void _winter_unused_##name(const uint64_t index __attribute__((unused)))
 
 #define TEST_ONLY __attribute__((unused, deprecated("should not be used outside of tests")))
 
 #endif
 
-#define _winter_test(name, i, threads, timeout)                                                                        \
-    if (index == WINTER_FUNC_INFO) {                                                                                   \
-        _winter_array_push(out, &(winter_test_t){ name, i + 6, threads, timeout });                                    \
-    }                                                                                                                  \
-    if (index == i + 6)
+#define _WINTER_CONCAT_(a, b) a##b
+#define _WINTER_CONCAT(a, b) _WINTER_CONCAT_(a, b)
 
-#define test(name, timeout, threads) _winter_test(name, __COUNTER__, threads, timeout * 1000)
+#define _winter_test(n, i, t, ms, ...)                                                                                 \
+    _winter_test_block(n, i, _WINTER_CONCAT(_winter_entry_, i), t, ms __VA_OPT__(, __VA_ARGS__))
+
+// The body runs once and then returns, so the blocks of the following tests are never checked after it.
+#define _winter_test_block(n, i, label, t, ms, ...)                                                                    \
+    if (_winter_local.entry != nullptr) {                                                                              \
+        void* _winter_entry = _winter_local.entry;                                                                     \
+        _winter_local.entry = nullptr;                                                                                 \
+        goto* _winter_entry;                                                                                           \
+    }                                                                                                                  \
+    static const winter_test_t _WINTER_CONCAT(_winter_descriptor_, i) = {                                              \
+        .name = n,                                                                                                     \
+        .id = i + 6,                                                                                                   \
+        .threads = t,                                                                                                  \
+        .timeout = ms,                                                                                                 \
+        .entry = &&label,                                                                                              \
+        .function = __func__,                                                                                          \
+        .file = __FILE__ __VA_OPT__(, __VA_ARGS__)                                                                     \
+    };                                                                                                                 \
+    _winter_register(winter_tests, winter_test_t, _WINTER_CONCAT(_winter_descriptor_, i));                             \
+    if (index != i + 6) {                                                                                              \
+    } else                                                                                                             \
+    label:                                                                                                             \
+        for (bool _winter_done = false;; _winter_done = true)                                                          \
+            if (_winter_done) {                                                                                        \
+                return;                                                                                                \
+            } else
+
+/// Test with a timeout in seconds and a number of threads. Optionally followed by fields of a winter_test_t, like the
+/// budget or the affinity, for example: test("name", 1, 4, .max_rss_mb = 64, .affinity = "spread")
+#define test(name, timeout, threads, ...) _winter_test(name, __COUNTER__, threads, timeout * 1000, __VA_ARGS__)
 
 #define it(name) _winter_test(name, __COUNTER__, 1, WINTER_DEFAULT_TIMEOUT_MS)
 
-#define parallel(name, threads)                                                                                        \
-    _winter_test(name " (parallel " #threads ")", __COUNTER__, threads, WINTER_DEFAULT_TIMEOUT_MS)
+/// Test running the body on a number of threads at the same time. Optionally followed by fields of a winter_test_t,
+/// for example: parallel("name", 4, .barrier = WINTER_BARRIER_SPIN, .affinity = "compact")
+#define parallel(name, threads, ...)                                                                                   \
+    _winter_test(name " (parallel " #threads ")", __COUNTER__, threads, WINTER_DEFAULT_TIMEOUT_MS, __VA_ARGS__)
+
+/// Runs the body repeatedly and reports timing statistics per iteration. Only runs with --bench. The suite function is
+/// compiled without optimizations unless WINTER_OPTIMIZE is defined, otherwise keep the measured code in a separate
+/// function. Pass its results through do_not_optimize.
+#define bench(name)                                                                                                    \
+    _winter_test(name, __COUNTER__, 1, WINTER_BENCH_TIMEOUT_MS, .bench = true)                                         \
+    for (winter_bench_t _winter_bench = { .iterations = 1 }; _winter_bench_next(&_winter_bench);)                      \
+        for (uint64_t _winter_i = 0; _winter_i < _winter_bench.iterations; ++_winter_i)
+
+/// Runs the body for a number of cases with inputs drawn from the generators below. The first failing case is shrunk
+/// to a small input, which is printed together with the --seed that reproduces it. A case that crashes the test
+/// process is shrunk by the runner in new processes.
+#define property(name, iterations)                                                                                     \
+    _winter_test(name, __COUNTER__, 1, WINTER_PROPERTY_TIMEOUT_MS, .property = true)                                   \
+    for (_winter_property_begin(iterations); _winter_property_next(_winter_local.property);)                           \
+        if (sigsetjmp(_winter_local.property->jump, 0) != 0) {                                                         \
+        } else
+
+/// Integer between min and max inclusive, shrinks towards zero.
+#define gen_int(min, max) _winter_gen_int(min, max)
+
+/// Unsigned integer up to max inclusive.
+#define gen_uint(max) _winter_gen_uint(max)
+
+#define gen_bool() (_winter_gen_uint(1) != 0)
+
+/// Fills the buffer with up to max_length random bytes. Returns the length.
+#define gen_bytes(buffer, max_length) _winter_gen_bytes(buffer, max_length)
+
+/// Fills the buffer with a printable string of up to max_length characters and a terminating zero. Returns the length.
+#define gen_str(buffer, max_length) _winter_gen_str(buffer, max_length)
+
+/// Reports a value of the test to the runner, which prints it with the result of the test. The name has to be a string
+/// literal, the runner reads it from its own copy of the binary.
+#define metric(name, value) _winter_record_metric("" name, (double)(value))
 
 #define before_each() if (index == WINTER_FUNC_BEFORE_EACH)
 
 #define after_each() if (index == WINTER_FUNC_AFTER_EACH)
 
+/// Runs once per suite in the runner process before the first test is forked. Tests inherit the fixture through
+/// copy-on-write memory. A failed assertion in here aborts the whole run.
+#define before_all() if (index == WINTER_FUNC_BEFORE_ALL)
+
+/// Runs once per suite in the runner process after the last test has finished.
+#define after_all() if (index == WINTER_FUNC_AFTER_ALL)
+
 #define thread_index() _winter_local.thread_id
 
-#define synchronize() _winter_thread_syncronize()
+#define synchronize() _winter_synchronize()
@@ -8,9 +8,8 @@
 
 #define try_alloc(ptr, size)                                                                                           \
     do {                                                                                                               \
-        ptr = malloc(size);                                                                                            \
+        ptr = calloc(1, size);                                                                                         \
         if (ptr == nullptr) {                                                                                          \
             failure(ENOMEM, msg("no memory for: " #ptr), with_int(size));                                              \
         }                                                                                                              \
-        memset(ptr, 0, size);                                                                                          \
     } while (0)
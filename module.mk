@@ -1,19 +1,28 @@
 MODULE_PATH := $(dir $(lastword $(MAKEFILE_LIST)))
 
-WINTER_SRCS := $(addprefix $(MODULE_PATH)src/, error.c)
+WINTER_SRCS := $(addprefix $(MODULE_PATH)src/, error.c arena.c)
 WINTER_HDRS := $(wildcard $(MODULE_PATH)include/**/*.h) 
 
 UNAME := $(shell uname -s)
 
-# configure sanitizers for the platform
+# configure sanitizers and allocation tracking for the platform, Darwin tracks allocations through malloc_logger
 ifeq ($(UNAME), Darwin)
     SANITIZER := -fsanitize=address,undefined
+    WINTER_ALLOC_LDFLAGS :=
 else ifeq ($(UNAME), Linux)
     SANITIZER := -fsanitize=address,undefined,leak
+    WINTER_ALLOC_LDFLAGS := -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
 else
     $(error unsupported platform)
 endif
 
 WINTER_CFLAGS      := -I$(MODULE_PATH)include
+WINTER_LDFLAGS     := -lm
 WINTER_DEB_CFLAGS  := -g -DDEBUG -O0 $(SANITIZER)
 WINTER_TEST_CFLAGS := -DWINTER_TEST $(WINTER_DBG_CFLAGS)
+
+# make ALLOC_TRACKING=1 counts the allocations of each test, see the allocation section of test.h
+ifdef ALLOC_TRACKING
+    WINTER_CFLAGS  += -DWINTER_ALLOC_TRACKING
+    WINTER_LDFLAGS += $(WINTER_ALLOC_LDFLAGS)
+endif
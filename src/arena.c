@@ -0,0 +1,179 @@
+// anonymous mappings are only declared for GNU sources on Linux, this has to come before any system header
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "winter/arena.h"
+#include "winter/error.h"
+#include "winter/utils.h"
+
+struct arena_chunk {
+    arena_chunk_t* next;
+    size_t size;
+
+    // end of the bytes handed out since the chunk was mapped, the memory after it is still zero
+    unsigned char* high;
+};
+
+#define ARENA_HEADER_SIZE ((sizeof(arena_chunk_t) + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1))
+
+static unsigned char*
+arena_chunk_data(arena_chunk_t* chunk) {
+    return (unsigned char*)chunk + ARENA_HEADER_SIZE;
+}
+
+static unsigned char*
+arena_chunk_end(arena_chunk_t* chunk) {
+    return (unsigned char*)chunk + chunk->size;
+}
+
+static void
+arena_use(arena_t* arena, arena_chunk_t* chunk) {
+    arena->current = chunk;
+    arena->cursor = arena_chunk_data(chunk);
+    arena->end = arena_chunk_end(chunk);
+}
+
+/// Moves the arena to a chunk with at least the number of free bytes, mapping one if the next chunk is too small.
+static result_t
+arena_grow(arena_t* arena, const size_t needed) {
+    arena_chunk_t* next = arena->current != nullptr ? arena->current->next : nullptr;
+    if (next != nullptr && (size_t)(arena_chunk_end(next) - arena_chunk_data(next)) >= needed) {
+        arena_use(arena, next);
+        return SUCCESS;
+    }
+
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t size = (max(arena->chunk_size, ARENA_HEADER_SIZE + needed) + page - 1) / page * page;
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        failure(errno, msg("failed to map an arena chunk"), with_uint(size));
+    }
+
+    arena_chunk_t* chunk = memory;
+    chunk->next = next;
+    chunk->size = size;
+    chunk->high = arena_chunk_data(chunk);
+
+    if (arena->current == nullptr) {
+        arena->first = chunk;
+    } else {
+        arena->current->next = chunk;
+    }
+
+    arena_use(arena, chunk);
+    return SUCCESS;
+}
+
+result_t
+arena_init(arena_t* arena, const size_t chunk_size) {
+    ensure(arena != nullptr);
+
+    *arena = (arena_t){ .chunk_size = chunk_size != 0 ? chunk_size : WINTER_ARENA_CHUNK_SIZE };
+    return SUCCESS;
+}
+
+result_t
+arena_alloc(arena_t* arena, size_t size, const size_t align, void** ptr) {
+    ensure(align != 0 && (align & (align - 1)) == 0, with_uint(align));
+
+    size = max(size, 1);
+
+    uintptr_t start = ((uintptr_t)arena->cursor + align - 1) & ~(uintptr_t)(align - 1);
+    if (arena->cursor == nullptr || start + size > (uintptr_t)arena->end) {
+        try(arena_grow(arena, size + align - 1));
+        start = ((uintptr_t)arena->cursor + align - 1) & ~(uintptr_t)(align - 1);
+    }
+
+    unsigned char* memory = (unsigned char*)start;
+    arena->cursor = memory + size;
+
+    // only the bytes used before the last reset need to be cleared, fresh pages are zero
+    arena_chunk_t* chunk = arena->current;
+    if (memory < chunk->high) {
+        memset(memory, 0, min(size, (size_t)(chunk->high - memory)));
+    }
+    if (arena->cursor > chunk->high) {
+        chunk->high = arena->cursor;
+    }
+
+    *ptr = memory;
+    return SUCCESS;
+}
+
+void
+arena_reset(arena_t* arena) {
+    if (arena->first != nullptr) {
+        arena_use(arena, arena->first);
+    }
+}
+
+void
+arena_destroy(arena_t* arena) {
+    for (arena_chunk_t* chunk = arena->first; chunk != nullptr;) {
+        arena_chunk_t* next = chunk->next;
+        munmap(chunk, chunk->size);
+        chunk = next;
+    }
+
+    *arena = (arena_t){ .chunk_size = arena->chunk_size };
+}
+
+result_t
+pool_init(pool_t* pool, const size_t size, const size_t chunk_size) {
+    ensure(pool != nullptr);
+    ensure(size != 0);
+
+    // freed objects hold the link of the free list
+    const size_t align = _Alignof(max_align_t);
+    pool->size = (max(size, sizeof(void*)) + align - 1) & ~(align - 1);
+    pool->free = nullptr;
+    try(arena_init(&pool->arena, chunk_size));
+
+    return SUCCESS;
+}
+
+result_t
+pool_alloc(pool_t* pool, void** ptr) {
+    if (pool->free != nullptr) {
+        void* object = pool->free;
+        pool->free = *(void**)object;
+        memset(object, 0, pool->size);
+
+        *ptr = object;
+        return SUCCESS;
+    }
+
+    try(arena_alloc(&pool->arena, pool->size, _Alignof(max_align_t), ptr));
+    return SUCCESS;
+}
+
+void
+pool_free(pool_t* pool, void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    *(void**)ptr = pool->free;
+    pool->free = ptr;
+}
+
+void
+pool_reset(pool_t* pool) {
+    pool->free = nullptr;
+    arena_reset(&pool->arena);
+}
+
+void
+pool_destroy(pool_t* pool) {
+    pool->free = nullptr;
+    arena_destroy(&pool->arena);
+}
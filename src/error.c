@@ -1,76 +1,639 @@
 #include <assert.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "winter/error.h"
 #include "winter/utils.h"
 
-#define MAX_ERRORS 32
+#define MAX_ERRORS WINTER_MAX_ERRORS
 
+_Thread_local int32_t error_last_code = 0;
+
+static error_site_t* _Atomic error_sites = nullptr;
+
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
 _Thread_local static error_frame_t error_list[MAX_ERRORS];
 _Thread_local static uint32_t error_count = 0;
-_Thread_local static int32_t error_code = 0;
+#endif
+
+#if WINTER_ERROR_LEVEL >= WINTER_ERROR_LEVEL_FULL
+
+// Messages are not formatted when they are appended. The frame buffer holds a record of the format string and the raw
+// arguments instead, which is rendered into text the first time the frame is read.
+typedef enum {
+    ARG_NONE,
+    ARG_FORMAT,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_INTMAX,
+    ARG_SIZE,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_PTR,
+    ARG_STR,
+} arg_type_t;
+
+typedef struct {
+    bool star_width;
+    bool star_precision;
+    arg_type_t type;
+    char conversion;
+} arg_spec_t;
+
+/// Parses the conversion specification starting after a '%'. Returns the character after it.
+static const char*
+arg_parse_spec(const char* it, arg_spec_t* spec) {
+    *spec = (arg_spec_t){ .type = ARG_NONE };
+
+    while (*it != '\0' && strchr("-+ #0'", *it) != nullptr) {
+        it += 1;
+    }
+
+    if (*it == '*') {
+        spec->star_width = true;
+        it += 1;
+    }
+    while (*it >= '0' && *it <= '9') {
+        it += 1;
+    }
+
+    if (*it == '.') {
+        it += 1;
+        if (*it == '*') {
+            spec->star_precision = true;
+            it += 1;
+        }
+        while (*it >= '0' && *it <= '9') {
+            it += 1;
+        }
+    }
+
+    arg_type_t integer = ARG_INT;
+    bool long_double = false;
+
+    if (it[0] == 'h') {
+        it += it[1] == 'h' ? 2 : 1;
+    } else if (it[0] == 'l') {
+        integer = it[1] == 'l' ? ARG_LLONG : ARG_LONG;
+        it += it[1] == 'l' ? 2 : 1;
+    } else if (it[0] == 'j') {
+        integer = ARG_INTMAX;
+        it += 1;
+    } else if (it[0] == 'z') {
+        integer = ARG_SIZE;
+        it += 1;
+    } else if (it[0] == 't') {
+        integer = ARG_PTRDIFF;
+        it += 1;
+    } else if (it[0] == 'L') {
+        long_double = true;
+        it += 1;
+    }
+
+    spec->conversion = *it;
+    switch (*it) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        spec->type = integer;
+        break;
+    case 'c':
+        spec->type = ARG_INT;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->type = long_double ? ARG_LDOUBLE : ARG_DOUBLE;
+        break;
+    case 'p':
+    case 'n':
+        spec->type = ARG_PTR;
+        break;
+    case 's':
+        spec->type = ARG_STR;
+        break;
+    case '\0':
+        return it;
+    default:
+        break;
+    }
+
+    return it + 1;
+}
+
+static bool
+arg_write(error_frame_t* frame, const arg_type_t type, const void* value, const size_t size) {
+    if (frame->size + 1 + size > sizeof(frame->msg)) {
+        return false;
+    }
+
+    frame->msg[frame->size] = (char)type;
+    memcpy(frame->msg + frame->size + 1, value, size);
+    frame->size += 1 + size;
+    return true;
+}
+
+static bool
+arg_write_str(error_frame_t* frame, const char* str) {
+    if (str == nullptr) {
+        str = "(null)";
+    }
+
+    const size_t room = sizeof(frame->msg) - frame->size;
+    if (room < 2) {
+        return false;
+    }
+
+    // strnlen is not part of standard C, memchr stops at the terminator as well
+    const size_t limit = min(room - 2, UINT8_MAX);
+    const char* end = memchr(str, '\0', limit);
+    const uint8_t length = (uint8_t)(end != nullptr ? (size_t)(end - str) : limit);
+    frame->msg[frame->size] = (char)ARG_STR;
+    frame->msg[frame->size + 1] = (char)length;
+    memcpy(frame->msg + frame->size + 2, str, length);
+    frame->size += 2 + length;
+    return true;
+}
+
+#define arg_record(frame, type, args, ctype)                                                                           \
+    do {                                                                                                               \
+        const ctype value = va_arg(args, ctype);                                                                       \
+        if (!arg_write(frame, type, &value, sizeof(value))) {                                                          \
+            return;                                                                                                    \
+        }                                                                                                              \
+    } while (0)
+
+static void
+arg_record_all(error_frame_t* frame, const char* format, va_list args) {
+    if (!arg_write(frame, ARG_FORMAT, (const void*)&format, sizeof(format))) {
+        return;
+    }
+
+    for (const char* it = strchr(format, '%'); it != nullptr; it = strchr(it, '%')) {
+        arg_spec_t spec;
+        it = arg_parse_spec(it + 1, &spec);
+
+        if (spec.star_width) {
+            arg_record(frame, ARG_INT, args, int);
+        }
+        if (spec.star_precision) {
+            arg_record(frame, ARG_INT, args, int);
+        }
+
+        switch (spec.type) {
+        case ARG_INT:
+            arg_record(frame, ARG_INT, args, int);
+            break;
+        case ARG_LONG:
+            arg_record(frame, ARG_LONG, args, long);
+            break;
+        case ARG_LLONG:
+            arg_record(frame, ARG_LLONG, args, long long);
+            break;
+        case ARG_INTMAX:
+            arg_record(frame, ARG_INTMAX, args, intmax_t);
+            break;
+        case ARG_SIZE:
+            arg_record(frame, ARG_SIZE, args, size_t);
+            break;
+        case ARG_PTRDIFF:
+            arg_record(frame, ARG_PTRDIFF, args, ptrdiff_t);
+            break;
+        case ARG_DOUBLE:
+            arg_record(frame, ARG_DOUBLE, args, double);
+            break;
+        case ARG_LDOUBLE:
+            arg_record(frame, ARG_LDOUBLE, args, long double);
+            break;
+        case ARG_PTR:
+            arg_record(frame, ARG_PTR, args, void*);
+            break;
+        case ARG_STR:
+            if (!arg_write_str(frame, va_arg(args, const char*))) {
+                return;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/// Reads the next recorded argument, which must have the type. Returns false if the record ends or does not match.
+static bool
+arg_read(const error_frame_t* frame, size_t* offset, const arg_type_t type, void* value, const size_t size) {
+    if (*offset + 1 + size > frame->size || (arg_type_t)frame->msg[*offset] != type) {
+        return false;
+    }
+
+    memcpy(value, frame->msg + *offset + 1, size);
+    *offset += 1 + size;
+    return true;
+}
+
+// reads an argument of the type and renders it with the specification, stops rendering if the record ends
+#define arg_render(text, length, spec, ctype)                                                                          \
+    do {                                                                                                               \
+        ctype value;                                                                                                   \
+        if (!arg_read(frame, &offset, type, &value, sizeof(value))) {                                                  \
+            goto done;                                                                                                 \
+        }                                                                                                              \
+        const int written = snprintf(text + length, sizeof(text) - length, spec, value);                               \
+        length += written > 0 ? min((size_t)written, sizeof(text) - length - 1) : 0;                                   \
+    } while (0)
+
+/// Renders the recorded messages into the message buffer of the frame.
+static void
+error_render(error_frame_t* frame) {
+    char text[sizeof(frame->msg)];
+    size_t length = 0;
+    size_t offset = 0;
+
+    const char* format;
+    while (arg_read(frame, &offset, ARG_FORMAT, (void*)&format, sizeof(format))) {
+        for (const char* it = format; *it != '\0' && length + 1 < sizeof(text);) {
+            if (*it != '%') {
+                text[length++] = *it++;
+                continue;
+            }
+            if (it[1] == '%') {
+                text[length++] = '%';
+                it += 2;
+                continue;
+            }
+
+            arg_spec_t spec_info;
+            const char* start = it;
+            it = arg_parse_spec(it + 1, &spec_info);
+
+            // copy the specification, replacing the * of the width and precision by their recorded values
+            char spec[64];
+            size_t spec_length = 0;
+            for (const char* c = start; c < it && spec_length + 12 < sizeof(spec); ++c) {
+                int star;
+                if (*c != '*') {
+                    spec[spec_length++] = *c;
+                } else if (arg_read(frame, &offset, ARG_INT, &star, sizeof(star))) {
+                    spec_length += (size_t)snprintf(spec + spec_length, sizeof(spec) - spec_length, "%d", star);
+                } else {
+                    goto done;
+                }
+            }
+            spec[spec_length] = '\0';
+
+            const arg_type_t type = spec_info.type;
+            switch (type) {
+            case ARG_INT:
+                arg_render(text, length, spec, int);
+                break;
+            case ARG_LONG:
+                arg_render(text, length, spec, long);
+                break;
+            case ARG_LLONG:
+                arg_render(text, length, spec, long long);
+                break;
+            case ARG_INTMAX:
+                arg_render(text, length, spec, intmax_t);
+                break;
+            case ARG_SIZE:
+                arg_render(text, length, spec, size_t);
+                break;
+            case ARG_PTRDIFF:
+                arg_render(text, length, spec, ptrdiff_t);
+                break;
+            case ARG_DOUBLE:
+                arg_render(text, length, spec, double);
+                break;
+            case ARG_LDOUBLE:
+                arg_render(text, length, spec, long double);
+                break;
+            case ARG_PTR:
+                if (spec_info.conversion == 'n') {
+                    void* ignored;
+                    if (!arg_read(frame, &offset, ARG_PTR, &ignored, sizeof(ignored))) {
+                        goto done;
+                    }
+                    break;
+                }
+                arg_render(text, length, spec, void*);
+                break;
+            case ARG_STR: {
+                if (offset + 2 > frame->size || (arg_type_t)frame->msg[offset] != ARG_STR) {
+                    goto done;
+                }
+
+                char str[UINT8_MAX + 1];
+                const uint8_t str_length = (uint8_t)frame->msg[offset + 1];
+                memcpy(str, frame->msg + offset + 2, str_length);
+                str[str_length] = '\0';
+                offset += 2 + str_length;
+
+                const int written = snprintf(text + length, sizeof(text) - length, spec, str);
+                length += written > 0 ? min((size_t)written, sizeof(text) - length - 1) : 0;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        if (length + 1 >= sizeof(text)) {
+            break;
+        }
+    }
+
+done:
+    text[length] = '\0';
+    memcpy(frame->msg, text, length + 1);
+    frame->size = 0;
+    frame->rendered = true;
+}
+
+#endif
 
 void
 error_push(const char* file, const char* func, const uint32_t line, const int32_t code) {
     assert(code != 0);
 
-    error_code = code;
+    error_last_code = code;
 
-    if (error_count >= MAX_ERRORS) {
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
+    // frames beyond the limit are counted, so their messages are not appended to the last stored frame
+    if (error_count++ >= MAX_ERRORS) {
         return;
     }
 
-    error_frame_t* frame = error_list + error_count++;
+    error_frame_t* frame = error_list + error_count - 1;
     frame->file = file;
     frame->func = func;
     frame->line = line;
     frame->code = code;
+    frame->size = 0;
+    frame->rendered = WINTER_ERROR_LEVEL < WINTER_ERROR_LEVEL_FULL;
     frame->msg[0] = '\0';
+#else
+    (void)file;
+    (void)func;
+    (void)line;
+#endif
 }
 
 __attribute__((__format__(__printf__, 1, 0))) void
 error_append_message(const char* format, ...) {
+#if WINTER_ERROR_LEVEL >= WINTER_ERROR_LEVEL_FULL
     assert(error_count > 0);
 
-    error_frame_t* frame = error_trace_nth(error_count - 1);
-    if (frame == nullptr) {
+    if (error_count > MAX_ERRORS) {
         return;
     }
 
-    const size_t offset = strlen(frame->msg);
-    if (offset >= sizeof(frame->msg)) {
-        return;
-    }
+    error_frame_t* frame = error_list + error_count - 1;
 
     va_list args;
     va_start(args, format);
-    vsnprintf(frame->msg + offset, sizeof(frame->msg) - offset, format, args);
+
+    if (!frame->rendered) {
+        arg_record_all(frame, format, args);
+    } else {
+        // the frame has been read already, append to the text directly
+        const size_t offset = strlen(frame->msg);
+        vsnprintf(frame->msg + offset, sizeof(frame->msg) - offset, format, args);
+    }
+
     va_end(args);
+#else
+    (void)format;
+#endif
 }
 
 int32_t
 error_get_code(void) {
-    return error_code;
+    return error_last_code;
 }
 
 uint32_t
 error_trace_length(void) {
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
     return min(error_count, MAX_ERRORS);
+#else
+    return 0;
+#endif
 }
 
 error_frame_t*
 error_trace_nth(const uint32_t n) {
-    if (n >= error_count || error_count >= MAX_ERRORS) {
+    if (n >= error_trace_length()) {
         return nullptr;
     }
 
-    return error_list + n;
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
+    error_frame_t* frame = error_list + n;
+#if WINTER_ERROR_LEVEL >= WINTER_ERROR_LEVEL_FULL
+    if (!frame->rendered) {
+        error_render(frame);
+    }
+#endif
+    return frame;
+#else
+    return nullptr;
+#endif
 }
 
 void
 error_clear(void) {
-    error_code = 0;
+    error_last_code = 0;
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
     error_count = 0;
+#endif
+}
+
+// a frame in a capture, followed by the used bytes of its message buffer and padding to the alignment of the next one
+typedef struct {
+    const char* file;
+    const char* func;
+    uint32_t line;
+    int32_t code;
+    uint16_t size;
+    bool rendered;
+} error_record_t;
+
+struct error_capture {
+    int32_t code;
+    uint32_t count;
+    uint32_t length;
+    size_t size;
+    error_record_t records[];
+};
+
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
+/// Returns the number of message bytes of the frame that have to be captured.
+static size_t
+error_record_msg_size(const error_frame_t* frame) {
+#if WINTER_ERROR_LEVEL >= WINTER_ERROR_LEVEL_FULL
+    return frame->rendered ? strlen(frame->msg) + 1 : frame->size;
+#else
+    (void)frame;
+    return 0;
+#endif
+}
+
+static size_t
+error_record_size(const size_t msg_size) {
+    const size_t align = _Alignof(error_record_t);
+    return (sizeof(error_record_t) + msg_size + align - 1) / align * align;
+}
+#endif
+
+size_t
+error_capture_size(void) {
+    size_t size = sizeof(error_capture_t);
+
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
+    for (uint32_t i = 0; i < error_trace_length(); ++i) {
+        size += error_record_size(error_record_msg_size(error_list + i));
+    }
+#endif
+
+    return size;
+}
+
+error_capture_t*
+error_capture_into(void* buffer, const size_t size) {
+    const size_t needed = error_capture_size();
+    if (buffer == nullptr || size < needed) {
+        return nullptr;
+    }
+
+    error_capture_t* capture = buffer;
+    capture->code = error_last_code;
+    capture->count = 0;
+    capture->length = 0;
+    capture->size = needed;
+
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
+    capture->count = error_count;
+    capture->length = error_trace_length();
+
+    unsigned char* it = (unsigned char*)capture->records;
+    for (uint32_t i = 0; i < capture->length; ++i) {
+        const error_frame_t* frame = error_list + i;
+        const size_t msg_size = error_record_msg_size(frame);
+
+        error_record_t* record = (error_record_t*)it;
+        *record = (error_record_t){
+            .file = frame->file,
+            .func = frame->func,
+            .line = frame->line,
+            .code = frame->code,
+            .size = (uint16_t)msg_size,
+            .rendered = frame->rendered,
+        };
+        memcpy(record + 1, frame->msg, msg_size);
+        it += error_record_size(msg_size);
+    }
+#endif
+
+    error_clear();
+    return capture;
+}
+
+error_capture_t*
+error_capture(void) {
+    const size_t size = error_capture_size();
+    void* buffer = malloc(size);
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+
+    return error_capture_into(buffer, size);
+}
+
+void
+error_capture_free(error_capture_t* capture) {
+    free(capture);
+}
+
+int32_t
+error_rethrow(const error_capture_t* capture) {
+    if (capture == nullptr || capture->code == 0) {
+        return SUCCESS;
+    }
+
+#if WINTER_ERROR_LEVEL > WINTER_ERROR_LEVEL_CODE
+    const unsigned char* it = (unsigned char*)capture->records;
+    for (uint32_t i = 0; i < capture->length; ++i) {
+        const error_record_t* record = (const error_record_t*)it;
+        it += error_record_size(record->size);
+
+        error_push(record->file, record->func, record->line, record->code);
+        if (error_count > MAX_ERRORS) {
+            continue;
+        }
+
+        error_frame_t* frame = error_list + error_count - 1;
+        memcpy(frame->msg, record + 1, record->size);
+        frame->rendered = record->rendered;
+        frame->size = record->rendered ? 0 : record->size;
+    }
+
+    // frames the worker could not store stay counted
+    error_count += capture->count - capture->length;
+#endif
+
+    error_last_code = capture->code;
+    return FAILURE;
+}
+
+void
+error_site_register(error_site_t* site) {
+    error_site_t* head = atomic_load_explicit(&error_sites, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&site->next, head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(
+      &error_sites, &head, site, memory_order_release, memory_order_relaxed
+    ));
+}
+
+error_site_t*
+error_sites_first(void) {
+    return atomic_load_explicit(&error_sites, memory_order_acquire);
+}
+
+error_site_t*
+error_sites_next(const error_site_t* site) {
+    return atomic_load_explicit(&site->next, memory_order_relaxed);
+}
+
+uint32_t
+error_sites_snapshot(error_site_snapshot_t* snapshots, const uint32_t capacity) {
+    uint32_t count = 0;
+
+    for (error_site_t* site = error_sites_first(); site != nullptr; site = error_sites_next(site), ++count) {
+        if (count >= capacity) {
+            continue;
+        }
+
+        snapshots[count] = (error_site_snapshot_t){
+            .file = site->file,
+            .func = site->func,
+            .line = site->line,
+            .code = atomic_load_explicit(&site->code, memory_order_relaxed),
+            .count = atomic_load_explicit(&site->count, memory_order_relaxed),
+        };
+    }
+
+    return count;
 }